@@ -5,362 +5,8449 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <iomanip>
 #include <chrono>
 #include <ctime>
 #include <sstream>
+#include <fstream>
 #include <algorithm>
 #include <cctype>
 #include <limits>
+#include <cstdlib>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <random>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
+#include <cerrno>
+#include <climits>
 
 #ifdef _WIN32
+// Keep windows.h from defining min/max macros over std::min/max and numeric_limits<T>::max().
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
+#include <io.h>
+#include <direct.h>
+#include <fcntl.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
 // Some toolchains may not define this constant; define if missing
 #ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
 #define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
 #endif
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define JC_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#else
+#define JC_IO_URING 0
+#endif
+
+// SQLite order storage is opt-in: -DJC_SQLITE=1 and link sqlite3.
+#ifndef JC_SQLITE
+#define JC_SQLITE 0
+#endif
+#if JC_SQLITE
+#include <sqlite3.h>
 #endif
 
 using namespace std;
 
 /* -------------------- ANSI COLOR HELPERS -------------------- */
+// A style is only written to streams with colour switched on (useColor);
+// pipes, files and the plain/JSON backends get the bare text.
+struct Style {
+    const char* code;
+};
+
+inline int colorSlot() {
+    static const int slot = ios_base::xalloc();
+    return slot;
+}
+
+inline void useColor(ostream& os, bool on) { os.iword(colorSlot()) = on ? 1 : 0; }
+
+inline ostream& operator<<(ostream& os, Style s) {
+    if (os.iword(colorSlot())) os << s.code;
+    return os;
+}
+
 namespace Colors {
-    const string RESET = "\x1B" "[0m";
-    const string TITLE = "\x1B" "[1;36m"; // bright cyan
-    const string SUBTLE = "\x1B" "[0;36m"; // cyan
-    const string HIGHL = "\x1B" "[1;32m"; // bright green
-    const string ACCENT = "\x1B" "[0;33m"; // yellow
-    const string ERR = "\x1B" "[1;31m"; // red
-    const string MUTED = "\x1B" "[0;37m"; // light gray
-    const string SOLD_OUT = "\x1B" "[0;31m"; // regular red
+    constexpr Style RESET{ "\x1B" "[0m" };
+    constexpr Style TITLE{ "\x1B" "[1;36m" }; // bright cyan
+    constexpr Style SUBTLE{ "\x1B" "[0;36m" }; // cyan
+    constexpr Style HIGHL{ "\x1B" "[1;32m" }; // bright green
+    constexpr Style ACCENT{ "\x1B" "[0;33m" }; // yellow
+    constexpr Style ERR{ "\x1B" "[1;31m" }; // red
+    constexpr Style MUTED{ "\x1B" "[0;37m" }; // light gray
+    constexpr Style SOLD_OUT{ "\x1B" "[0;31m" }; // regular red
 }
 
 /* -------------------- Enable ANSI on Windows (best-effort) -------------------- */
-void enableAnsiOnWindows() {
+// False when the console cannot show escape sequences; the caller falls
+// back to plain output.
+bool enableAnsiOnWindows() {
 #ifdef _WIN32
     HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (hOut == INVALID_HANDLE_VALUE) return;
+    if (hOut == INVALID_HANDLE_VALUE) return false;
     DWORD dwMode = 0;
-    if (!GetConsoleMode(hOut, &dwMode)) return;
+    if (!GetConsoleMode(hOut, &dwMode)) return false;
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-    // ignore failure: if it fails, we continue without colors
-    SetConsoleMode(hOut, dwMode);
+    return SetConsoleMode(hOut, dwMode) != 0;
+#else
+    return true;
 #endif
 }
 
-/* -------------------- Utility: Safe Input Parsers -------------------- */
-string readLineTrimmed() {
-    string s;
-    if (!std::getline(cin, s)) return "";
-    // Remove possible '\r' left by Windows CRLF
-    if (!s.empty() && s.back() == '\r') s.pop_back();
-    const char* ws = " \t\n\r\f\v";
-    size_t start = s.find_first_not_of(ws);
-    if (start == string::npos) return "";
-    size_t end = s.find_last_not_of(ws);
-    return s.substr(start, end - start + 1);
+bool stdoutIsTerminal() {
+#ifdef _WIN32
+    return _isatty(_fileno(stdout)) != 0;
+#else
+    return isatty(STDOUT_FILENO) != 0;
+#endif
 }
 
-int readIntInRange(const string& prompt, int minVal, int maxVal) {
-    while (true) {
-        cout << prompt;
-        string line;
-        if (!std::getline(cin, line)) { // robust to EOF
-            cin.clear();
-            continue;
-        }
-        // trim windows CR
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        stringstream ss(line);
-        int x;
-        if (ss >> x && ss.eof()) {
-            if (x < minVal || x > maxVal) {
-                cout << Colors::ERR << "Please enter a number between "
-                    << minVal << " and " << maxVal << "." << Colors::RESET << "\n";
-                continue;
-            }
-            return x;
-        }
-        cout << Colors::ERR << "Invalid number. Try again." << Colors::RESET << "\n";
-    }
-}
+/* -------------------- Allocation Accounting -------------------- */
+// Two independent views of the heap:
+//  - phases (opt-in with --alloc-stats): every operator new is charged to the
+//    ordering phase the calling thread is in; when off the only cost is one
+//    relaxed load per allocation.
+//  - owners (always on): every block carries a small header naming the
+//    structure it was allocated for, so live bytes per structure are exact
+//    even after the block changes hands or is freed from another scope.
+//    Each thread counts into its own slab, summed only when a report asks,
+//    so the cost is the header and two thread-local adds.
+enum class AllocPhase : int { Other, Name, DineOption, Browse, AddLine, Checkout, Counter, Count };
+const int ALLOC_PHASES = static_cast<int>(AllocPhase::Count);
+const char* const ALLOC_PHASE_NAMES[] = { "other", "name", "dine option", "browse", "add line", "checkout", "counter" };
 
-bool readYesNo(const string& prompt) {
-    while (true) {
-        cout << prompt;
-        string line;
-        if (!std::getline(cin, line)) {
-            cin.clear();
-            continue;
-        }
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-        if (line == "y" || line == "yes") return true;
-        if (line == "n" || line == "no") return false;
-        cout << Colors::ERR << "Please answer Y or N." << Colors::RESET << "\n";
+struct AllocCounter {
+    atomic<unsigned long long> calls{ 0 };
+    atomic<unsigned long long> bytes{ 0 };
+};
+
+namespace AllocStats {
+    atomic<bool> enabled{ false };
+    AllocCounter counters[ALLOC_PHASES];
+    thread_local AllocPhase phase = AllocPhase::Other;
+    thread_local unsigned long long threadCalls = 0; // this thread's share of the counters
+
+    inline void charge(size_t n) {
+        if (!enabled.load(memory_order_relaxed)) return;
+        ++threadCalls;
+        AllocCounter& c = counters[static_cast<int>(phase)];
+        c.calls.fetch_add(1, memory_order_relaxed);
+        c.bytes.fetch_add(n, memory_order_relaxed);
     }
 }
 
-/* -------------------- Domain Classes -------------------- */
-struct Item {
-    string name;
-    double price;
-    int qty;
-    string category;
-    int sold = 0;
+enum class MemTag : uint32_t { Other, Menu, MenuIndexes, Orders, OrderBoard, WaitTimes, Sketches, Journal, Scratch, Tape, Pool, EventLog, Count };
+const int MEM_TAGS = static_cast<int>(MemTag::Count);
+const char* const MEM_TAG_NAMES[] = { "other", "menu", "menu indexes", "orders", "order board",
+    "wait times", "sketches", "journal", "scratch buffers", "session tape", "task queues", "event log" };
 
-    Item(const string& n = "", double p = 0.0, int q = 0, const string& c = "")
-        : name(n), price(p), qty(q), category(c) {
-    }
+struct MemCounter {
+    atomic<long long> bytes{ 0 };
+    atomic<long long> blocks{ 0 };
 };
 
-struct OrderLine {
-    Item* item;
-    int quantity;
-    double subtotal() const { return (item ? item->price * quantity : 0.0); }
+// One thread's live bytes and blocks per owner. Only that thread writes
+// it; a block freed on another thread is subtracted there, so only the sum
+// over all slabs means anything.
+struct alignas(64) MemSlab {
+    atomic<long long> bytes[MEM_TAGS];
+    atomic<long long> blocks[MEM_TAGS];
+    MemSlab* next = nullptr;
+    MemSlab* prev = nullptr;
+    bool linked = false, retired = false;
 };
 
-class Order {
-public:
-    string customerName;
-    string dineOption;
-    vector<OrderLine> lines;
-    unsigned long long receiptNo = 0;
-    chrono::system_clock::time_point timestamp;
+namespace MemStats {
+    thread_local MemTag tag = MemTag::Other;
+    thread_local MemSlab slab; // trivially destroyed: stays usable while other thread_locals are freed
+    mutex slabsLock;
+    MemSlab* slabs = nullptr;  // of live threads
+    MemCounter retired[MEM_TAGS]; // what ended threads left counted
 
-    Order() {
-        timestamp = chrono::system_clock::now();
+    // Folds the thread's slab into `retired` when the thread ends; later
+    // frees on that thread go to `retired` directly.
+    struct SlabRetirer {
+        void arm() {}
+        ~SlabRetirer() {
+            MemSlab& s = slab;
+            lock_guard<mutex> lk(slabsLock);
+            for (int t = 0; t < MEM_TAGS; ++t) {
+                retired[t].bytes.fetch_add(s.bytes[t].load(memory_order_relaxed), memory_order_relaxed);
+                retired[t].blocks.fetch_add(s.blocks[t].load(memory_order_relaxed), memory_order_relaxed);
+            }
+            if (s.prev) s.prev->next = s.next;
+            else slabs = s.next;
+            if (s.next) s.next->prev = s.prev;
+            s.retired = true;
+        }
+    };
+    thread_local SlabRetirer retirer;
+
+#ifdef _MSC_VER
+    __declspec(noinline)
+#else
+    __attribute__((noinline))
+#endif
+    void link(MemSlab& s) {
+        retirer.arm();
+        lock_guard<mutex> lk(slabsLock);
+        s.next = slabs;
+        if (slabs) slabs->prev = &s;
+        slabs = &s;
+        s.linked = true;
     }
 
-    double total() const {
-        double t = 0.0;
-        for (const auto& l : lines) t += l.subtotal();
-        return t;
+    inline void count(uint32_t t, long long bytes, long long blocks) {
+        MemSlab& s = slab;
+        if (!s.linked) link(s);
+        if (s.retired) {
+            retired[t].bytes.fetch_add(bytes, memory_order_relaxed);
+            retired[t].blocks.fetch_add(blocks, memory_order_relaxed);
+            return;
+        }
+        s.bytes[t].store(s.bytes[t].load(memory_order_relaxed) + bytes, memory_order_relaxed);
+        s.blocks[t].store(s.blocks[t].load(memory_order_relaxed) + blocks, memory_order_relaxed);
     }
 
-    void printReceipt() const {
-        time_t tt = chrono::system_clock::to_time_t(timestamp);
+    // Live bytes and blocks for owner `t`, summed over every thread.
+    void live(int t, long long& bytes, long long& blocks) {
+        lock_guard<mutex> lk(slabsLock);
+        bytes = retired[t].bytes.load(memory_order_relaxed);
+        blocks = retired[t].blocks.load(memory_order_relaxed);
+        for (const MemSlab* s = slabs; s; s = s->next) {
+            bytes += s->bytes[t].load(memory_order_relaxed);
+            blocks += s->blocks[t].load(memory_order_relaxed);
+        }
+    }
+}
 
-        // portable localtime handling
-        tm local_tm{};
-#ifdef _WIN32
-        localtime_s(&local_tm, &tt);
+// Padded to malloc's alignment, so the payload is aligned for any
+// fundamental type on 32- and 64-bit builds alike.
+struct alignas(alignof(max_align_t)) BlockHeader {
+    size_t size;
+    uint32_t tag;
+};
+static_assert(sizeof(BlockHeader) % alignof(max_align_t) == 0, "block header must preserve malloc's alignment");
+
+void* allocateTracked(size_t n) noexcept {
+    if (n > SIZE_MAX - sizeof(BlockHeader)) return nullptr;
+    AllocStats::charge(n);
+    BlockHeader* h = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + n));
+    if (!h) return nullptr;
+    h->size = n;
+    h->tag = static_cast<uint32_t>(MemStats::tag);
+    MemStats::count(h->tag, static_cast<long long>(n), 1);
+    return h + 1;
+}
+
+// Kept out of line: once inlined next to operator new, GCC pairs the
+// allocation with this free() of the header and warns of a mismatch.
+#ifdef _MSC_VER
+__declspec(noinline)
 #else
-        localtime_r(&tt, &local_tm);
+__attribute__((noinline))
 #endif
+void releaseTracked(void* p) noexcept {
+    if (!p) return;
+    BlockHeader* h = static_cast<BlockHeader*>(p) - 1;
+    MemStats::count(h->tag, -static_cast<long long>(h->size), -1);
+    free(h);
+}
 
-        char timebuf[64];
-        strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &local_tm);
+void* operator new(size_t n) {
+    void* p = allocateTracked(n);
+    if (!p) throw bad_alloc();
+    return p;
+}
+void* operator new[](size_t n) { return operator new(n); }
+void* operator new(size_t n, const nothrow_t&) noexcept { return allocateTracked(n); }
+void* operator new[](size_t n, const nothrow_t&) noexcept { return allocateTracked(n); }
+void operator delete(void* p) noexcept { releaseTracked(p); }
+void operator delete[](void* p) noexcept { releaseTracked(p); }
+void operator delete(void* p, size_t) noexcept { releaseTracked(p); }
+void operator delete[](void* p, size_t) noexcept { releaseTracked(p); }
+void operator delete(void* p, const nothrow_t&) noexcept { releaseTracked(p); }
+void operator delete[](void* p, const nothrow_t&) noexcept { releaseTracked(p); }
 
-        cout << Colors::TITLE << "\n=== James' Café Receipt ===" << Colors::RESET << "\n";
-        cout << Colors::SUBTLE << "Receipt# " << receiptNo << "     " << timebuf << Colors::RESET << "\n";
-        cout << Colors::MUTED << "Customer: " << customerName << "     (" << dineOption << ")" << Colors::RESET << "\n\n";
-        cout << left << setw(30) << "Item" << setw(6) << "Qty" << setw(12) << "Subtotal" << "\n";
-        cout << "-----------------------------------------------\n";
-        for (const auto& l : lines) {
-            cout << left << setw(30) << (l.item ? l.item->name : string("(unknown)"))
-                << setw(6) << l.quantity
-                << "₱ " << fixed << setprecision(2) << l.subtotal() << "\n";
+// Blocks allocated in this scope belong to `t` until freed.
+class MemScope {
+public:
+    explicit MemScope(MemTag t) : saved(MemStats::tag) { MemStats::tag = t; }
+    ~MemScope() { MemStats::tag = saved; }
+    MemScope(const MemScope&) = delete;
+    MemScope& operator=(const MemScope&) = delete;
+private:
+    MemTag saved;
+};
+
+// Charges allocations in this scope to `p`, restoring the outer phase after.
+class AllocPhaseScope {
+public:
+    explicit AllocPhaseScope(AllocPhase p) : saved(AllocStats::phase) { AllocStats::phase = p; }
+    ~AllocPhaseScope() { AllocStats::phase = saved; }
+    AllocPhaseScope(const AllocPhaseScope&) = delete;
+    AllocPhaseScope& operator=(const AllocPhaseScope&) = delete;
+private:
+    AllocPhase saved;
+};
+
+// Per-order view on top of the phase counters. An order is counted on the
+// thread that takes it, so the shipper, log and journal threads running
+// meanwhile don't land in its total.
+class AllocReport {
+public:
+    void beginOrder() { startCalls = AllocStats::threadCalls; }
+
+    void endOrder() {
+        unsigned long long n = AllocStats::threadCalls - startCalls;
+        orders++;
+        orderCalls += n;
+        if (n > maxCalls) maxCalls = n;
+    }
+
+    double callsPerOrder() const { return orders ? static_cast<double>(orderCalls) / orders : 0.0; }
+
+    void print(ostream& out) const {
+        out << "\nAllocations by phase (" << orders << " orders):\n";
+        out << left << setw(14) << "  phase" << right << setw(12) << "calls" << setw(14) << "bytes"
+            << setw(14) << "calls/order" << "\n";
+        for (int i = 0; i < ALLOC_PHASES; ++i) {
+            unsigned long long calls = AllocStats::counters[i].calls.load();
+            unsigned long long bytes = AllocStats::counters[i].bytes.load();
+            out << "  " << left << setw(12) << ALLOC_PHASE_NAMES[i] << right << setw(12) << calls
+                << setw(14) << bytes << setw(14) << fixed << setprecision(2)
+                << (orders ? static_cast<double>(calls) / orders : 0.0) << "\n";
         }
-        cout << "-----------------------------------------------\n";
-        cout << Colors::HIGHL << "TOTAL: ₱ " << fixed << setprecision(2) << total() << Colors::RESET << "\n";
-        cout << Colors::TITLE << "Thank you for choosing James' Café — come back soon! ☕\n\n" << Colors::RESET;
+        out << "  per order: avg " << fixed << setprecision(2) << callsPerOrder() << ", max " << maxCalls << "\n";
     }
+
+private:
+    unsigned long long startCalls = 0;
+    unsigned long long orders = 0;
+    unsigned long long orderCalls = 0;
+    unsigned long long maxCalls = 0;
 };
 
-/* -------------------- App Helpers -------------------- */
-void printBackstory() {
-    cout << Colors::TITLE
-        << "Welcome to James' Café — A cozy corner for your calm mornings.\n"
-        << Colors::RESET;
-    cout << Colors::MUTED
-        << "Here we brew slow, chat quietly, and make every cup with care.\n\n"
-        << Colors::RESET;
+/* -------------------- Session Record & Replay -------------------- */
+// Capture file, one record per line:
+//   I <ms since start> <input line>       every line the cashier typed
+//   R <ms since start> <receipt digest>   every receipt printed (escaped)
+// Replaying feeds the I records back at the recorded pace (scaled by
+// `speed`, 0 = as fast as possible) and checks each receipt against R.
+string escapeField(const string& s) {
+    string out;
+    for (char c : s) {
+        if (c == '\\') out += "\\\\";
+        else if (c == '\n') out += "\\n";
+        else out += c;
+    }
+    return out;
 }
 
-// **NEW HELPER FUNCTION**
-bool isCategorySoldOut(const vector<Item>& menu, const string& category) {
-    for (const auto& item : menu) {
-        if (item.category == category && item.qty > 0) {
-            return false; // Found an item in stock
+string unescapeField(const string& s) {
+    string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 1 < s.size()) {
+            out += s[i + 1] == 'n' ? '\n' : s[i + 1];
+            ++i;
         }
+        else out += s[i];
     }
-    return true; // All items in the category are out of stock
+    return out;
 }
 
-// **UPDATED FUNCTION**
-void showCategories(const vector<Item>& menu) {
-    cout << Colors::SUBTLE << "Menu categories:\n" << Colors::RESET;
+class SessionTape {
+public:
+    bool openRecord(const string& path) {
+        MemScope scope(MemTag::Tape);
+        file.open(path, ios::out | ios::trunc);
+        if (!file) return false;
+        file << "# James' Cafe session capture v1\n";
+        mode = Mode::Record;
+        start = chrono::steady_clock::now();
+        return true;
+    }
 
-    auto printCategory = [&](int num, const string& name) {
-        cout << num << ") " << name;
-        if (isCategorySoldOut(menu, name)) {
-            cout << Colors::SOLD_OUT << " [SOLD OUT]" << Colors::RESET;
+    bool openReplay(const string& path, double speedFactor) {
+        MemScope scope(MemTag::Tape);
+        ifstream in(path);
+        if (!in) return false;
+        string line;
+        while (std::getline(in, line)) {
+            if (line.size() < 2 || line[0] == '#') continue;
+            size_t sp = line.find(' ', 2);
+            if (sp == string::npos) continue;
+            long long ms = strtoll(line.c_str() + 2, nullptr, 10);
+            string payload = line.substr(sp + 1);
+            if (line[0] == 'I') inputs.push_back(make_pair(ms, payload));
+            else if (line[0] == 'R') receipts.push_back(unescapeField(payload));
         }
-        cout << "\n";
-        };
+        mode = Mode::Replay;
+        speed = speedFactor;
+        start = chrono::steady_clock::now();
+        return true;
+    }
 
-    printCategory(1, "Beverages");
-    printCategory(2, "Snacks");
-    printCategory(3, "Meals");
-    printCategory(4, "Desserts");
-    cout << "0) Finish order\n";
-}
+    // In-memory replay for benchmarks: no timing, no receipts to compare.
+    void loadScript(const vector<string>& lines) {
+        MemScope scope(MemTag::Tape);
+        inputs.clear();
+        for (const auto& l : lines) inputs.push_back(make_pair(0LL, l));
+        receipts.clear();
+        orderMs.clear();
+        mismatches.clear();
+        nextInput = 0;
+        inputEnded = false;
+        speed = 0.0;
+        mode = Mode::Script;
+    }
+
+    bool replaying() const { return mode == Mode::Replay; }
+    bool capturing() const { return mode == Mode::Record || mode == Mode::Replay; }
+    bool ended() const { return inputEnded; }
 
-vector<Item*> listAvailableInCategory(vector<Item>& menu, const string& cat) {
-    vector<Item*> available;
-    for (auto& it : menu) {
-        if (it.category == cat && it.qty > 0) available.push_back(&it);
+    bool readLine(string& line) {
+        if (mode == Mode::Replay || mode == Mode::Script) {
+            if (nextInput >= inputs.size()) { inputEnded = true; return false; }
+            const auto& rec = inputs[nextInput++];
+            if (speed > 0.0) {
+                this_thread::sleep_until(start + chrono::microseconds(static_cast<long long>(rec.first * 1000.0 / speed)));
+            }
+            line = rec.second;
+            return true;
+        }
+        if (!std::getline(cin, line)) { inputEnded = true; return false; }
+        if (mode == Mode::Record) file << "I " << elapsedMs() << " " << line << "\n";
+        return true;
     }
-    if (available.empty()) {
-        cout << Colors::MUTED << "(No available items in " << cat << ")\n" << Colors::RESET;
-        return available;
+
+    void orderStarted() { orderStart = chrono::steady_clock::now(); }
+
+    void orderFinished(const string& digest) {
+        MemScope scope(MemTag::Tape);
+        if (mode == Mode::Record) {
+            file << "R " << elapsedMs() << " " << escapeField(digest) << "\n";
+            file.flush();
+        }
+        else if (mode == Mode::Replay) {
+            orderMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - orderStart).count());
+            size_t k = orderMs.size() - 1;
+            if (k >= receipts.size() || receipts[k] != digest) mismatches.push_back(k + 1);
+        }
     }
-    for (size_t i = 0; i < available.size(); ++i) {
-        cout << (i + 1) << ") " << available[i]->name
-            << "  ₱ " << fixed << setprecision(2) << available[i]->price
-            << "  (" << available[i]->qty << " left)\n";
+
+    void report(ostream& out) const {
+        if (mode != Mode::Replay) return;
+        vector<double> sorted = orderMs;
+        sort(sorted.begin(), sorted.end());
+        auto pct = [&](double p) { return sorted.empty() ? 0.0 : sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+        double wall = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        out << fixed << setprecision(3)
+            << "Replay: " << orderMs.size() << " orders (" << receipts.size() << " recorded) in " << wall << " ms\n"
+            << "  per order ms: min " << pct(0.0) << "  p50 " << pct(0.5) << "  p95 " << pct(0.95)
+            << "  max " << pct(1.0) << "\n";
+        if (mismatches.empty() && orderMs.size() == receipts.size()) {
+            out << "  receipts: all match\n";
+            return;
+        }
+        out << "  receipts: " << mismatches.size() << " mismatched";
+        for (size_t i = 0; i < mismatches.size() && i < 10; ++i) out << (i ? ", #" : " (order #") << mismatches[i];
+        out << (mismatches.empty() ? "" : ")") << "\n";
     }
-    cout << "0) Back to categories\n";
-    return available;
-}
 
-unsigned long long generateReceiptNumber() {
-    static unsigned long long counter = 0ULL;
-    unsigned long long millis = static_cast<unsigned long long>(
-        chrono::duration_cast<chrono::milliseconds>(
-            chrono::system_clock::now().time_since_epoch()).count());
-    // combine time and counter to reduce collisions
-    return (millis % 1000000000ULL) + (++counter);
+    // true when the replay diverged from the capture
+    bool failed() const { return mode == Mode::Replay && (!mismatches.empty() || orderMs.size() != receipts.size()); }
+
+private:
+    enum class Mode { Live, Record, Replay, Script };
+    Mode mode = Mode::Live;
+    ofstream file;
+    chrono::steady_clock::time_point start, orderStart;
+    vector<pair<long long, string>> inputs;
+    vector<string> receipts;
+    size_t nextInput = 0;
+    double speed = 1.0;
+    bool inputEnded = false;
+    vector<double> orderMs;
+    vector<size_t> mismatches;
+
+    long long elapsedMs() const {
+        return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+SessionTape& sessionTape() {
+    static SessionTape tape;
+    return tape;
 }
 
-/* -------------------- Main Program -------------------- */
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+/* -------------------- Output Backends -------------------- */
+// Screens (menus, prompts, the board) go to screen(). Receipts and the day
+// summary are records: the selected backend renders each into a pooled
+// buffer that is written in one piece. JSON lines keep stdout for records
+// and move the screens to stderr, so a pipe sees nothing but records.
+enum class OutputFormat { Ansi, Plain, JsonLines };
 
-    enableAnsiOnWindows();
+class Output {
+public:
+    Output() { pool.reserve(8); }
 
-    vector<Item> menu = {
-        Item("Cappuccino", 140.00, 20, "Beverages"),
-        Item("Latte", 150.00, 20, "Beverages"),
-        Item("Iced Americano", 120.00, 20, "Beverages"),
-        Item("Chocolate Milkshake", 190.00, 20, "Beverages"),
-        Item("Blueberry Muffin", 75.00, 20, "Snacks"),
-        Item("Garlic Parmesan Toast", 95.00, 20, "Snacks"),
-        Item("Glazed Donut Holes", 100.00, 20, "Snacks"),
-        Item("Chicken Wrap", 180.00, 20, "Meals"),
-        Item("Garlic Rice + Burger", 220.00, 20, "Meals"),
-        Item("Chicken Alfredo Pasta", 275.00, 20, "Meals"),
-        Item("Chocolate Cake Slice", 130.00, 20, "Desserts"),
-        Item("Fruit Parfait", 110.00, 20, "Desserts"),
-        Item("Tiramisu", 270.00, 20, "Desserts")
-    };
+    void select(OutputFormat f) {
+        format = f;
+        useColor(cout, f == OutputFormat::Ansi);
+        useColor(cerr, false);
+    }
 
-    vector<Order> allOrders;
-    int customersServed = 0;
+    OutputFormat current() const { return format; }
+    bool json() const { return format == OutputFormat::JsonLines; }
+    ostream& screen() { return json() ? cerr : cout; }
 
-    printBackstory();
+    // Buffers keep their capacity between records, so steady-state output
+    // does not allocate.
+    string acquire() {
+        lock_guard<mutex> lk(poolMutex);
+        if (pool.empty()) return string();
+        string s = std::move(pool.back());
+        pool.pop_back();
+        s.clear();
+        return s;
+    }
 
-    while (true) {
-        cout << Colors::ACCENT << "---- New Customer ----" << Colors::RESET << "\n";
+    void release(string&& s) {
+        lock_guard<mutex> lk(poolMutex);
+        pool.push_back(std::move(s));
+    }
 
-        Order order;
-        order.receiptNo = generateReceiptNumber();
+    // JSON lines are flushed per record so a consumer sees each order as it
+    // commits.
+    void write(string&& record) {
+        cout.write(record.data(), static_cast<streamsize>(record.size()));
+        if (json()) cout.flush();
+        release(std::move(record));
+    }
 
-        while (true) {
-            cout << "Enter customer name: ";
-            string name = readLineTrimmed();
-            if (name.empty()) {
-                cout << Colors::ERR << "Name cannot be empty.\n" << Colors::RESET;
-                continue;
+private:
+    OutputFormat format = OutputFormat::Plain;
+    mutex poolMutex;
+    vector<string> pool;
+};
+
+Output& output() {
+    static Output out;
+    return out;
+}
+
+// ostream over a borrowed string, so the text backends can reuse the
+// existing stream formatting while rendering into a pooled buffer.
+class StringSink : public streambuf {
+public:
+    void attach(string* s) { target = s; }
+protected:
+    int overflow(int c) override {
+        if (c != traits_type::eof()) target->push_back(static_cast<char>(c));
+        return c;
+    }
+    streamsize xsputn(const char* p, streamsize n) override {
+        target->append(p, static_cast<size_t>(n));
+        return n;
+    }
+private:
+    string* target = nullptr;
+};
+
+ostream& recordStream(string& buf) {
+    struct Stream {
+        StringSink sink;
+        ostream os{ &sink };
+    };
+    static thread_local Stream s;
+    s.sink.attach(&buf);
+    useColor(s.os, output().current() == OutputFormat::Ansi);
+    return s.os;
+}
+
+// Writes every part, in order, with as few system calls as the platform
+// allows: one writev on POSIX (split only on a short write), one
+// concatenated write on Windows.
+bool writeParts(int fd, const string* const* parts, size_t n) {
+#ifdef _WIN32
+    string joined;
+    for (size_t i = 0; i < n; ++i) joined += *parts[i];
+    size_t done = 0;
+    while (done < joined.size()) {
+        int w = _write(fd, joined.data() + done, static_cast<unsigned>(min<size_t>(joined.size() - done, INT_MAX)));
+        if (w <= 0) return false;
+        done += static_cast<size_t>(w);
+    }
+    return true;
+#else
+    const size_t MAX_IOV = 64;
+    iovec iov[MAX_IOV];
+    for (size_t first = 0; first < n; first += MAX_IOV) {
+        size_t count = min(MAX_IOV, n - first);
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = const_cast<char*>(parts[first + i]->data());
+            iov[i].iov_len = parts[first + i]->size();
+        }
+        iovec* cur = iov;
+        while (count > 0) {
+            if (cur->iov_len == 0) { ++cur; --count; continue; }
+            ssize_t w = ::writev(fd, cur, static_cast<int>(count));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            size_t left = static_cast<size_t>(w);
+            while (count > 0 && left >= cur->iov_len) { left -= cur->iov_len; ++cur; --count; }
+            if (count > 0) {
+                cur->iov_base = static_cast<char*>(cur->iov_base) + left;
+                cur->iov_len -= left;
             }
-            order.customerName = name;
-            break;
         }
+    }
+    return true;
+#endif
+}
 
-        bool isEatIn = readYesNo("Dine option - Eat in? or Take-Out (Y/N): ");
-        order.dineOption = isEatIn ? "Eat-In" : "Take-Out";
+// One ordering session's output. Screen text and records collect in the
+// session's own buffers and go out in one vectored write per flush, at
+// each prompt and receipt, so concurrent sessions never interleave
+// mid-screen and never share a stream lock.
+class SessionOutput {
+public:
+    // recordFd / screenFd: where records and screens go; by default stdout,
+    // with screens on stderr in JSON mode.
+    explicit SessionOutput(int recordFd = 1, int screenFd = -1)
+        : recordFd(recordFd), screenFd(screenFd >= 0 ? screenFd : (output().json() ? 2 : recordFd)) {
+        parts.reserve(8);
+        batch.reserve(8);
+        useColor(os, output().current() == OutputFormat::Ansi);
+    }
 
-        while (true) {
-            showCategories(menu); // **UPDATED CALL**
-            int catChoice = readIntInRange("Choose category (0-4): ", 0, 4);
-            if (catChoice == 0) break;
+    ~SessionOutput() { flush(); }
 
-            string category;
-            switch (catChoice) {
-            case 1: category = "Beverages"; break;
-            case 2: category = "Snacks"; break;
-            case 3: category = "Meals"; break;
-            case 4: category = "Desserts"; break;
-            default: category = ""; break;
-            }
-            if (category.empty()) continue;
+    SessionOutput(const SessionOutput&) = delete;
+    SessionOutput& operator=(const SessionOutput&) = delete;
 
-            // **NEW LOGIC: Check if the selected category is sold out**
-            if (isCategorySoldOut(menu, category)) {
-                cout << Colors::ERR << "Sorry, " << category << " is completely sold out for today.\n" << Colors::RESET;
-                continue; // Go back to category selection
+    ostream& screen() {
+        if (!screenOpen) {
+            parts.push_back(Part{ spareBuffer(), screenFd });
+            screenOpen = true;
+        }
+        sink.attach(&parts.back().text);
+        return os;
+    }
+
+    void record(string&& text) {
+        parts.push_back(Part{ std::move(text), recordFd });
+        screenOpen = false;
+    }
+
+    void flush() {
+        if (parts.empty()) return;
+        for (int fd : { recordFd, screenFd }) {
+            batch.clear();
+            for (const auto& p : parts) if (p.fd == fd) batch.push_back(&p.text);
+            if (!batch.empty()) {
+                writeParts(fd, batch.data(), batch.size());
+                ++writes;
             }
+            if (screenFd == recordFd) break;
+        }
+        for (auto& p : parts) {
+            p.text.clear();
+            spare.push_back(std::move(p.text));
+        }
+        parts.clear();
+        screenOpen = false;
+    }
 
-            vector<Item*> available = listAvailableInCategory(menu, category);
-            // This check is technically redundant if isCategorySoldOut is used, but kept for robustness
-            if (available.empty()) continue;
+    size_t writeCalls() const { return writes; }
+
+private:
+    struct Part {
+        string text;
+        int fd;
+    };
 
-            int itemChoice = readIntInRange("Select item number (0 to go back): ", 0, static_cast<int>(available.size()));
-            if (itemChoice == 0) continue;
+    int recordFd;
+    int screenFd;
+    vector<Part> parts;
+    vector<const string*> batch;
+    vector<string> spare; // buffers keep their capacity between flushes
+    bool screenOpen = false;
+    size_t writes = 0;
+    StringSink sink;
+    ostream os{ &sink };
 
-            Item* chosen = available[itemChoice - 1];
-            if (!chosen) { cout << Colors::ERR << "Unexpected error selecting item.\n" << Colors::RESET; continue; }
+    string spareBuffer() {
+        if (spare.empty()) return string();
+        string s = std::move(spare.back());
+        spare.pop_back();
+        return s;
+    }
+};
+
+// The session whose output this thread is producing, if any; bound per
+// task, so a session can move between pool workers.
+thread_local SessionOutput* boundSession = nullptr;
+
+class SessionBinding {
+public:
+    explicit SessionBinding(SessionOutput& s) : saved(boundSession) { boundSession = &s; }
+    ~SessionBinding() { boundSession = saved; }
+    SessionBinding(const SessionBinding&) = delete;
+    SessionBinding& operator=(const SessionBinding&) = delete;
+private:
+    SessionOutput* saved;
+};
 
-            int qty = readIntInRange("Enter quantity: ", 1, chosen->qty);
+ostream& screen() { return boundSession ? boundSession->screen() : output().screen(); }
 
-            OrderLine line{ chosen, qty };
-            order.lines.push_back(line);
-            chosen->qty -= qty;
-            chosen->sold += qty;
+// A finished screen: the session's buffers go out in one write; without a
+// session the shared stream is flushed so the prompt is visible.
+void flushScreen() {
+    if (boundSession) boundSession->flush();
+    else output().screen().flush();
+}
 
-            cout << Colors::HIGHL << qty << " x " << chosen->name << " added to order." << Colors::RESET << "\n";
+// A session's records join its screens and go out with them; otherwise
+// they are written straight away.
+void writeRecord(string&& record) {
+    if (boundSession) {
+        boundSession->record(std::move(record));
+        boundSession->flush();
+    }
+    else {
+        output().write(std::move(record));
+    }
+}
 
-            bool addMore = readYesNo("Add more items? (Y/N): ");
-            if (!addMore) {
-                bool continueOrdering = readYesNo("Continue ordering (another category)? (Y/N): ");
-                if (!continueOrdering) break;
+void appendJsonString(string& out, string_view s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned>(c));
+                out += esc;
             }
+            else out += c;
         }
+    }
+    out += '"';
+}
 
-        if (order.lines.empty()) {
-            cout << Colors::MUTED << "No items ordered. Cancelling this transaction.\n" << Colors::RESET;
-        }
-        else {
-            order.printReceipt();
-            allOrders.push_back(order);
-            customersServed++;
-        }
+void appendFixed(string& out, double v, int decimals = 2) {
+    char buf[48];
+    int n = snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    out.append(buf, static_cast<size_t>(max(n, 0)));
+}
 
-        bool next = readYesNo("Serve next customer? (Y/N): ");
-        if (!next) break;
-    }
+void appendUnsigned(string& out, unsigned long long v) {
+    char buf[24];
+    int n = 0;
+    do { buf[n++] = static_cast<char>('0' + v % 10); v /= 10; } while (v);
+    while (n) out += buf[--n];
+}
 
-    // Daily summary
-    cout << Colors::TITLE << "\n=== Daily Summary ===\n" << Colors::RESET;
-    double totalRevenue = 0.0;
-    int totalItemsSold = 0;
-    for (auto& o : allOrders) totalRevenue += o.total();
-    for (auto& it : menu) totalItemsSold += it.sold;
+/* -------------------- Event Log -------------------- */
+// Business and diagnostic events (orders committed and voided, items added,
+// sold out or running low, journal segments sealed or failing) written as
+// JSON lines to the file given with --log. A log call copies one fixed-size
+// record into a bounded lock-free ring and returns; a background thread
+// formats and writes. When the ring is full the event is dropped and
+// counted: logging never holds up an order.
+enum class Event : uint8_t { OrderCommitted, OrderVoided, ItemAdded, SoldOut, StockLow, SegmentSealed, JournalFailed, LineChanged };
 
-    cout << "Customers served: " << customersServed << "\n";
-    cout << "Total revenue: ₱ " << fixed << setprecision(2) << totalRevenue << "\n";
-    cout << "Total items sold: " << totalItemsSold << "\n";
+const int LOW_STOCK = 5; // stock_low fires when an item's stock drops to this
 
-    Item* best = nullptr;
-    for (auto& it : menu) if (!best || it.sold > best->sold) best = &it;
-    if (best && best->sold > 0) cout << "Best seller: " << best->name << " (" << best->sold << " sold)\n";
-    else cout << "No sales recorded.\n";
+struct EventRecord {
+    uint64_t epochMs;
+    uint64_t id;          // receipt# or segment#
+    double amount;
+    int32_t n[2];
+    const char* item;     // a menu item's name, which outlives the log
+    uint32_t itemLength;
+    Event kind;
+    char customer[19];    // truncated copy, NUL-padded
+};
+static_assert(sizeof(EventRecord) == 64, "one cache line per event");
+
+// JSON keys of each event's fields; nullptr leaves the field out.
+struct EventSchema {
+    const char* name;
+    const char* id;
+    const char* n0;
+    const char* n1;
+    const char* amount;
+};
 
-    cout << "\nRemaining inventory:\n";
-    for (auto& it : menu) cout << "- " << it.name << " : " << it.qty << " left\n";
+const EventSchema EVENT_SCHEMA[] = {
+    { "order_committed", "receipt", "units", "lines", "total" },
+    { "order_voided", nullptr, nullptr, nullptr, nullptr },
+    { "item_added", nullptr, "qty", "left", nullptr },
+    { "sold_out", nullptr, nullptr, nullptr, nullptr },
+    { "stock_low", nullptr, "left", nullptr, nullptr },
+    { "segment_sealed", "segment", "orders", nullptr, nullptr },
+    { "journal_failed", "segment", nullptr, nullptr, nullptr },
+    { "line_changed", nullptr, "delta", "left", nullptr }
+};
+
+class EventLog {
+public:
+    static const size_t CAPACITY = size_t(1) << 14;
+
+    ~EventLog() { close(); }
 
-    cout << Colors::TITLE << "\nThank you for running James' Café today. Good job! ☕\n" << Colors::RESET;
+    // Appends to `path`; the ring is allocated only once logging is on.
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+#endif
+        if (fd < 0) return false;
+        MemScope scope(MemTag::EventLog);
+        slots.reset(new Slot[CAPACITY]);
+        for (size_t i = 0; i < CAPACITY; ++i) slots[i].seq.store(i, memory_order_relaxed);
+        head.store(0, memory_order_relaxed);
+        tail = 0;
+        dropped.store(0, memory_order_relaxed);
+        written.store(0, memory_order_relaxed);
+        stopping.store(false, memory_order_relaxed);
+        formatter = thread([this]() { run(); });
+        on.store(true, memory_order_release);
+        return true;
+    }
+
+    bool enabled() const { return on.load(memory_order_relaxed); }
+
+    // Bounded MPMC ring (Vyukov): a slot's sequence number says whether it
+    // is free for position `pos` (== pos) or holds its record (== pos + 1).
+    void log(const EventRecord& r) {
+        size_t pos = head.load(memory_order_relaxed);
+        Slot* s;
+        while (true) {
+            s = &slots[pos & (CAPACITY - 1)];
+            const size_t seq = s->seq.load(memory_order_acquire);
+            const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (dif == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            }
+            else if (dif < 0) {
+                dropped.fetch_add(1, memory_order_relaxed); // full: the formatter is behind
+                return;
+            }
+            else {
+                pos = head.load(memory_order_relaxed);
+            }
+        }
+        s->record = r;
+        s->seq.store(pos + 1, memory_order_release);
+    }
+
+    // Stops taking events, writes out the ones already queued.
+    void close() {
+        if (fd < 0) return;
+        on.store(false, memory_order_relaxed);
+        stopping.store(true, memory_order_release);
+        if (formatter.joinable()) formatter.join();
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+
+    unsigned long long droppedCount() const { return dropped.load(memory_order_relaxed); }
+    unsigned long long writtenCount() const { return written.load(memory_order_relaxed); }
+
+private:
+    struct Slot {
+        atomic<size_t> seq{ 0 };
+        EventRecord record;
+    };
+
+    unique_ptr<Slot[]> slots;
+    alignas(64) atomic<size_t> head{ 0 };
+    alignas(64) size_t tail = 0; // formatter thread only
+    atomic<unsigned long long> dropped{ 0 };
+    atomic<bool> on{ false }, stopping{ false };
+    atomic<unsigned long long> written{ 0 };
+    int fd = -1;
+    thread formatter;
+
+    // Polls: a producer never pays for a wake-up.
+    void run() {
+        string out;
+        while (true) {
+            const bool stop = stopping.load(memory_order_acquire);
+            size_t n = 0;
+            while (true) {
+                Slot& s = slots[tail & (CAPACITY - 1)];
+                if (s.seq.load(memory_order_acquire) != tail + 1) break;
+                format(s.record, out);
+                s.seq.store(tail + CAPACITY, memory_order_release);
+                ++tail;
+                ++n;
+                if (out.size() >= 65536) flush(out);
+            }
+            flush(out);
+            written.fetch_add(n, memory_order_relaxed);
+            if (n == 0) {
+                if (stop) break;
+                this_thread::sleep_for(chrono::milliseconds(2));
+            }
+        }
+    }
+
+    void flush(string& out) {
+        if (out.empty()) return;
+        const string* part = &out;
+        writeParts(fd, &part, 1);
+        out.clear();
+    }
+
+    static void format(const EventRecord& r, string& out) {
+        const EventSchema& e = EVENT_SCHEMA[static_cast<int>(r.kind)];
+        auto key = [&](const char* k) {
+            out += ",\"";
+            out += k;
+            out += "\":";
+        };
+        out += "{\"ts_ms\":";
+        appendUnsigned(out, r.epochMs);
+        out += ",\"event\":\"";
+        out += e.name;
+        out += '"';
+        if (e.id) { key(e.id); appendUnsigned(out, r.id); }
+        if (r.item) { key("item"); appendJsonString(out, string_view(r.item, r.itemLength)); }
+        if (r.customer[0]) {
+            key("customer");
+            appendJsonString(out, string_view(r.customer, strnlen(r.customer, sizeof(r.customer))));
+        }
+        const char* const counts[2] = { e.n0, e.n1 };
+        for (int i = 0; i < 2; ++i) {
+            if (!counts[i]) continue;
+            key(counts[i]);
+            if (r.n[i] < 0) out += '-';
+            appendUnsigned(out, static_cast<unsigned long long>(r.n[i] < 0 ? -static_cast<long long>(r.n[i]) : r.n[i]));
+        }
+        if (e.amount) { key(e.amount); appendFixed(out, r.amount); }
+        out += "}\n";
+    }
+};
+
+EventLog& eventLog() {
+    static EventLog log;
+    return log;
+}
+
+// Event times only need to order events for a reader: the coarse clock
+// (a few ms of resolution) costs a few ns where a full read costs ~30.
+inline uint64_t eventClockMs() {
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + static_cast<uint64_t>(ts.tv_nsec) / 1000000;
+#else
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// The call sites' entry point: a single relaxed load when logging is off.
+inline void logEvent(Event kind, string_view item = {}, int32_t n0 = 0, int32_t n1 = 0, uint64_t id = 0,
+    double amount = 0.0, string_view customer = {}) {
+    EventLog& log = eventLog();
+    if (!log.enabled()) return;
+    EventRecord r;
+    r.epochMs = eventClockMs();
+    r.id = id;
+    r.amount = amount;
+    r.n[0] = n0;
+    r.n[1] = n1;
+    r.item = item.empty() ? nullptr : item.data();
+    r.itemLength = static_cast<uint32_t>(item.size());
+    r.kind = kind;
+    const size_t c = min(customer.size(), sizeof(r.customer));
+    memcpy(r.customer, customer.data(), c);
+    memset(r.customer + c, 0, sizeof(r.customer) - c);
+    log.log(r);
+}
+
+/* -------------------- Utility: Safe Input Parsers -------------------- */
+// All terminal input goes through here so sessions can be recorded and replayed.
+bool readInputLine(string& line) {
+    flushScreen();
+    if (!sessionTape().readLine(line)) return false;
+    // Remove possible '\r' left by Windows CRLF
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    return true;
+}
+
+// Once input is exhausted the prompts below stop looping and return the
+// "back out" answer (minimum / no), which winds the app down to the summary.
+bool inputEnded() { return sessionTape().ended(); }
+
+string readLineTrimmed() {
+    string s;
+    if (!readInputLine(s)) return "";
+    const char* ws = " \t\n\r\f\v";
+    size_t start = s.find_first_not_of(ws);
+    if (start == string::npos) return "";
+    size_t end = s.find_last_not_of(ws);
+    s.erase(end + 1);
+    s.erase(0, start); // trim in place: no second string
+    return s;
+}
+
+// Journal and menu records are tab-separated lines, so names typed in or
+// read from files must not carry tabs or line breaks.
+void blankSeparators(string& s) {
+    for (char& c : s) {
+        if (c == '\t' || c == '\r' || c == '\n') c = ' ';
+    }
+}
+
+// Prompts take const char* and reuse one line buffer per thread, so asking
+// a question does not allocate.
+int readIntInRange(const char* prompt, int minVal, int maxVal) {
+    static thread_local string line;
+    while (true) {
+        screen() << prompt;
+        if (!readInputLine(line)) return minVal; // robust to EOF
+        const char* begin = line.c_str();
+        char* end = nullptr;
+        errno = 0;
+        long v = strtol(begin, &end, 10);
+        if (end != begin && *end == '\0' && errno != ERANGE && v >= INT_MIN && v <= INT_MAX) {
+            int x = static_cast<int>(v);
+            if (x < minVal || x > maxVal) {
+                screen() << Colors::ERR << "Please enter a number between "
+                    << minVal << " and " << maxVal << "." << Colors::RESET << "\n";
+                continue;
+            }
+            return x;
+        }
+        screen() << Colors::ERR << "Invalid number. Try again." << Colors::RESET << "\n";
+    }
+}
+
+bool readYesNo(const char* prompt) {
+    static thread_local string line;
+    while (true) {
+        screen() << prompt;
+        if (!readInputLine(line)) return false;
+        transform(line.begin(), line.end(), line.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (line == "y" || line == "yes") return true;
+        if (line == "n" || line == "no") return false;
+        screen() << Colors::ERR << "Please answer Y or N." << Colors::RESET << "\n";
+    }
+}
+
+/* -------------------- Domain Classes -------------------- */
+// Name and category are views: into string literals for the embedded menu,
+// or into the owning Menu's interned text for loaded ones.
+struct Item {
+    string_view name;
+    double price;
+    int qty;
+    string_view category;
+    int sold = 0;
+
+    constexpr Item(string_view n = {}, double p = 0.0, int q = 0, string_view c = {})
+        : name(n), price(p), qty(q), category(c) {
+    }
+};
+
+/* -------------------- Dietary / Allergen Attributes -------------------- */
+// One bit per attribute. "Contains" bits are excluded with a must-not mask,
+// lifestyle bits (vegan, vegetarian) are required with a must-have mask.
+typedef uint16_t AttrMask;
+enum : AttrMask {
+    ATTR_VEGAN = 1u << 0,
+    ATTR_VEGETARIAN = 1u << 1,
+    ATTR_GLUTEN = 1u << 2,
+    ATTR_NUTS = 1u << 3,
+    ATTR_DAIRY = 1u << 4,
+    ATTR_EGG = 1u << 5,
+    ATTR_CAFFEINE = 1u << 6
+};
+
+struct DietFilter {
+    AttrMask mustHave = 0;
+    AttrMask mustNot = 0;
+
+    bool active() const { return mustHave != 0 || mustNot != 0; }
+    bool matches(AttrMask a) const { return (a & mustHave) == mustHave && (a & mustNot) == 0; }
+};
+
+// Customer-facing presets; each one toggles a single bit in one of the masks.
+struct DietPreset {
+    const char* label;
+    AttrMask bit;
+    bool required; // true: must have, false: must not have
+};
+
+const DietPreset DIET_PRESETS[] = {
+    { "Vegan", ATTR_VEGAN, true },
+    { "Vegetarian", ATTR_VEGETARIAN, true },
+    { "Gluten-free", ATTR_GLUTEN, false },
+    { "Nut-free", ATTR_NUTS, false },
+    { "Dairy-free", ATTR_DAIRY, false },
+    { "Egg-free", ATTR_EGG, false },
+    { "Caffeine-free", ATTR_CAFFEINE, false }
+};
+const int DIET_PRESET_COUNT = static_cast<int>(sizeof(DIET_PRESETS) / sizeof(DIET_PRESETS[0]));
+
+bool isPresetOn(const DietFilter& f, const DietPreset& p) {
+    return ((p.required ? f.mustHave : f.mustNot) & p.bit) != 0;
+}
+
+string describeFilter(const DietFilter& f) {
+    string out;
+    for (const auto& p : DIET_PRESETS) {
+        if (!isPresetOn(f, p)) continue;
+        if (!out.empty()) out += ", ";
+        out += p.label;
+    }
+    return out.empty() ? string("none") : out;
+}
+
+/* -------------------- Inventory Merkle Tree -------------------- */
+// One hash per item over (name, qty, sold), combined pairwise up to a
+// root. A stock movement rehashes one leaf-to-root path: O(log n). Two
+// trees over the same item order have equal roots exactly when every item
+// agrees (barring a 64-bit collision), and diff() finds the items that
+// disagree by descending only into subtrees whose hashes differ: O(log n)
+// comparisons per divergent item. The hashes catch drift, not tampering;
+// they are not cryptographic.
+class InventoryTree {
+public:
+    static uint64_t mix(uint64_t h) {
+        h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+        h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+        return h ^ (h >> 31);
+    }
+
+    static uint64_t leaf(string_view name, int qty, int sold) {
+        uint64_t h = 1469598103934665603ULL; // FNV-1a
+        for (unsigned char c : name) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return mix(h ^ mix((static_cast<uint64_t>(static_cast<uint32_t>(qty)) << 32) | static_cast<uint32_t>(sold)));
+    }
+
+    // Sizes the tree for n items, all zero; set() the leaves, then rebuild().
+    void assign(size_t n) {
+        leaves = n;
+        width = 1;
+        while (width < n) width <<= 1;
+        nodes.assign(2 * width, 0);
+    }
+
+    void set(size_t i, uint64_t h) { nodes[width + i] = h; }
+
+    void rebuild() {
+        for (size_t k = width - 1; k >= 1; --k) nodes[k] = combine(nodes[2 * k], nodes[2 * k + 1]);
+    }
+
+    void update(size_t i, uint64_t h) {
+        size_t k = width + i;
+        nodes[k] = h;
+        for (k >>= 1; k >= 1; k >>= 1) nodes[k] = combine(nodes[2 * k], nodes[2 * k + 1]);
+    }
+
+    uint64_t root() const { return nodes.size() > 1 ? nodes[1] : 0; }
+    size_t size() const { return leaves; }
+
+    // Items whose leaves differ, in index order; false if the trees do not
+    // cover the same number of items.
+    bool diff(const InventoryTree& other, vector<size_t>& out, size_t& comparisons) const {
+        out.clear();
+        comparisons = 0;
+        if (leaves != other.leaves || nodes.size() != other.nodes.size()) return false;
+        vector<size_t> stack{ 1 };
+        while (!stack.empty()) {
+            size_t k = stack.back();
+            stack.pop_back();
+            ++comparisons;
+            if (nodes[k] == other.nodes[k]) continue;
+            if (k >= width) {
+                out.push_back(k - width);
+                continue;
+            }
+            stack.push_back(2 * k + 1); // left child on top: results come out in order
+            stack.push_back(2 * k);
+        }
+        return true;
+    }
+
+    void serialize(string& out) const {
+        const uint64_t n = leaves;
+        out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(uint64_t));
+    }
+
+    bool deserialize(const char*& p, const char* end) {
+        uint64_t n = 0;
+        if (static_cast<size_t>(end - p) < sizeof(n)) return false;
+        memcpy(&n, p, sizeof(n));
+        p += sizeof(n);
+        if (n > (uint64_t(1) << 32)) return false;
+        assign(static_cast<size_t>(n));
+        const size_t bytes = nodes.size() * sizeof(uint64_t);
+        if (static_cast<size_t>(end - p) < bytes) return false;
+        memcpy(nodes.data(), p, bytes);
+        p += bytes;
+        return true;
+    }
+
+private:
+    size_t leaves = 0, width = 1;
+    vector<uint64_t> nodes{ 0, 0 }; // heap order from 1; leaves at [width, 2 * width)
+
+    static uint64_t combine(uint64_t left, uint64_t right) {
+        return mix(left ^ (right * 0x9E3779B97F4A7C15ULL + 0x632BE59BD9B4E019ULL));
+    }
+};
+
+/* -------------------- Menu -------------------- */
+inline bool bitTest(const vector<uint64_t>& bits, size_t i) {
+    return (bits[i / 64] >> (i % 64)) & 1ULL;
+}
+
+inline void bitAssign(vector<uint64_t>& bits, size_t i, bool on) {
+    if (on) bits[i / 64] |= 1ULL << (i % 64);
+    else bits[i / 64] &= ~(1ULL << (i % 64));
+}
+
+enum class SortBy { MenuOrder, Price, Popularity };
+
+// "Drinks under 150, no dairy, in stock, by popularity" for the kiosk.
+struct MenuQuery {
+    string category;                                // empty: any category
+    double minPrice = 0.0;
+    double maxPrice = numeric_limits<double>::max();
+    DietFilter diet;
+    bool inStockOnly = true;
+    SortBy sort = SortBy::Popularity;
+    size_t limit = 0;                               // 0: no limit
+};
+
+// Items plus their attribute bitsets, kept in a parallel array so a filter
+// pass touches 2 bytes per item instead of walking the Item structs.
+class Menu {
+public:
+    vector<Item> items;
+    vector<AttrMask> attrs; // attrs[i] belongs to items[i]
+    mutex guard;            // held around query + stock changes when sessions run concurrently
+
+    // The item's name and category must outlive the menu: literals, or
+    // views returned by intern().
+    void add(const Item& item, AttrMask a = 0) {
+        MemScope scope(MemTag::Menu);
+        items.push_back(item);
+        attrs.push_back(a);
+        fixedFind = nullptr;
+        indexesStale = true;
+    }
+
+    void reserve(size_t n) {
+        MemScope scope(MemTag::Menu);
+        items.reserve(n);
+        attrs.reserve(n);
+    }
+
+    // Keeps a copy of runtime text (menu files, generated names) for Items
+    // to point at; deque elements never move.
+    string_view intern(const string& s) {
+        MemScope scope(MemTag::Menu);
+        text.push_back(s);
+        return text.back();
+    }
+
+    // A compile-time name index for a fixed item table; replaces the hash
+    // map until the next add().
+    void useFixedIndex(long (*find)(string_view)) {
+        fixedFind = find;
+        indexesStale = true;
+    }
+
+    // Swaps in a whole item table that build(items, attrs) makes from a
+    // copy of this one (the same items in the same order, then any new
+    // ones), and rebuilds the indexes. The guard is held from the copy to
+    // the swap, so no stock change is lost in between. False, and nothing
+    // swapped, if build returns false. Item pointers into the old table are
+    // left dangling; holders re-point them by index.
+    template <typename Build>
+    bool replaceItems(Build build) {
+        MemScope scope(MemTag::Menu);
+        lock_guard<mutex> lock(guard);
+        ensureIndexes();
+        vector<Item> next = items;
+        vector<AttrMask> nextAttrs = attrs;
+        if (!build(next, nextAttrs)) return false;
+        if (next.size() != items.size()) fixedFind = nullptr;
+        items.swap(next);
+        attrs.swap(nextAttrs);
+        buildIndexes();
+        return true;
+    }
+
+    size_t indexOf(const Item* item) const { return static_cast<size_t>(item - items.data()); }
+
+    size_t size() const { return items.size(); }
+    vector<Item>::iterator begin() { return items.begin(); }
+    vector<Item>::iterator end() { return items.end(); }
+    vector<Item>::const_iterator begin() const { return items.begin(); }
+    vector<Item>::const_iterator end() const { return items.end(); }
+
+    // Evaluates the filter over the whole menu: bit (i % 64) of out[i / 64] is
+    // set when items[i] passes. Four 16-bit masks are tested per 64-bit word
+    // (SWAR), so the inner loop has no per-item branches.
+    void filter(const DietFilter& f, vector<uint64_t>& out) const {
+        const size_t n = attrs.size();
+        out.assign((n + 63) / 64, 0ULL);
+        if (!f.active()) {
+            for (size_t i = 0; i < n; ++i) out[i / 64] |= 1ULL << (i % 64);
+            return;
+        }
+
+        const uint64_t LANES = 0x0001000100010001ULL;
+        const uint64_t LOW15 = 0x7FFF7FFF7FFF7FFFULL;
+        const uint64_t HIGH = 0x8000800080008000ULL;
+        const uint64_t need = LANES * f.mustHave;
+        const uint64_t deny = LANES * f.mustNot;
+
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint64_t w;
+            memcpy(&w, &attrs[i], sizeof(w));
+            // a lane is bad if it misses a required bit or has a denied one
+            uint64_t bad = (~w & need) | (w & deny);
+            // set the high bit of every non-zero lane
+            uint64_t nz = (((bad & LOW15) + LOW15) | bad) & HIGH;
+            uint64_t ok = ~nz & HIGH;
+            uint64_t bits = ((ok >> 15) & 1ULL) | ((ok >> 30) & 2ULL)
+                | ((ok >> 45) & 4ULL) | ((ok >> 60) & 8ULL);
+            out[i / 64] |= bits << (i % 64);
+        }
+        for (; i < n; ++i) {
+            if (f.matches(attrs[i])) out[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+
+    /* ---- Secondary indexes ---- */
+    // Rebuilt only when items are added; stock and sales keep them current
+    // through adjustStock().
+    void buildIndexes() {
+        MemScope scope(MemTag::MenuIndexes);
+        const size_t n = items.size();
+        categories.clear();
+        catOf.assign(n, 0);
+        for (size_t i = 0; i < n; ++i) {
+            int c = categoryId(items[i].category);
+            if (c < 0) {
+                c = static_cast<int>(categories.size());
+                categories.push_back(items[i].category);
+            }
+            catOf[i] = static_cast<uint16_t>(c);
+        }
+
+        byPrice.resize(n);
+        for (size_t i = 0; i < n; ++i) byPrice[i] = static_cast<uint32_t>(i);
+        byCatPrice = byPrice;
+        byPopularity = byPrice;
+
+        stable_sort(byPrice.begin(), byPrice.end(), [&](uint32_t a, uint32_t b) {
+            return items[a].price < items[b].price;
+            });
+        stable_sort(byCatPrice.begin(), byCatPrice.end(), [&](uint32_t a, uint32_t b) {
+            if (catOf[a] != catOf[b]) return catOf[a] < catOf[b];
+            return items[a].price < items[b].price;
+            });
+        stable_sort(byPopularity.begin(), byPopularity.end(), [&](uint32_t a, uint32_t b) {
+            return items[a].sold > items[b].sold;
+            });
+
+        priceKeys();
+
+        popPos.resize(n);
+        for (size_t k = 0; k < n; ++k) popPos[byPopularity[k]] = static_cast<uint32_t>(k);
+
+        // live runs never outnumber items, so the pool does not grow after this
+        runs.clear();
+        runs.reserve(n);
+        freeRuns.clear();
+        freeRuns.reserve(n);
+        runOf.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            const int sold = items[byPopularity[k]].sold;
+            if (k == 0 || runs.back().sold != sold) {
+                runs.push_back(PopularityRun{ sold, static_cast<uint32_t>(k), static_cast<uint32_t>(k) });
+            }
+            else runs.back().last = static_cast<uint32_t>(k);
+            runOf[byPopularity[k]] = static_cast<uint32_t>(runs.size() - 1);
+        }
+
+        inStock.assign((n + 63) / 64, 0ULL);
+        for (size_t i = 0; i < n; ++i) bitAssign(inStock, i, items[i].qty > 0);
+
+        byName.clear();
+        if (!fixedFind) {
+            byName.reserve(n);
+            for (size_t i = 0; i < n; ++i) byName[items[i].name] = static_cast<uint32_t>(i);
+        }
+
+        stock.assign(n);
+        for (size_t i = 0; i < n; ++i) stock.set(i, InventoryTree::leaf(items[i].name, items[i].qty, items[i].sold));
+        stock.rebuild();
+
+        indexesStale = false;
+    }
+
+    void ensureIndexes() {
+        if (indexesStale) buildIndexes();
+    }
+
+    // After the prices or categories of `changed` items were edited in
+    // place: those are taken out of the price indexes and merged back in,
+    // one pass over each instead of a full sort. Ties keep item order, as
+    // buildIndexes() leaves them.
+    void reindexPrices(const vector<uint32_t>& changed) {
+        if (indexesStale) {
+            buildIndexes();
+            return;
+        }
+        if (changed.empty()) return;
+        MemScope scope(MemTag::MenuIndexes);
+        vector<bool> moved(items.size(), false);
+        for (uint32_t i : changed) {
+            int c = categoryId(items[i].category);
+            if (c < 0) {
+                c = static_cast<int>(categories.size());
+                categories.push_back(items[i].category);
+            }
+            catOf[i] = static_cast<uint16_t>(c);
+            moved[i] = true;
+        }
+        auto byPriceOrder = [&](uint32_t a, uint32_t b) {
+            return items[a].price != items[b].price ? items[a].price < items[b].price : a < b;
+        };
+        auto byCatPriceOrder = [&](uint32_t a, uint32_t b) {
+            return catOf[a] != catOf[b] ? catOf[a] < catOf[b] : byPriceOrder(a, b);
+        };
+        vector<uint32_t> sorted, merged;
+        auto remerge = [&](vector<uint32_t>& index, auto order) {
+            sorted.clear();
+            for (uint32_t i = 0; i < moved.size(); ++i) {
+                if (moved[i]) sorted.push_back(i);
+            }
+            sort(sorted.begin(), sorted.end(), order);
+            index.erase(remove_if(index.begin(), index.end(), [&](uint32_t i) { return moved[i]; }), index.end());
+            merged.resize(index.size() + sorted.size());
+            merge(index.begin(), index.end(), sorted.begin(), sorted.end(), merged.begin(), order);
+            index.swap(merged);
+        };
+        remerge(byPrice, byPriceOrder);
+        remerge(byCatPrice, byCatPriceOrder);
+        priceKeys();
+    }
+
+    // Merkle tree over every item's stock and sales, kept current by
+    // adjustStock(); direct writes to qty/sold show up as divergence.
+    const InventoryTree& stockTree() {
+        ensureIndexes();
+        return stock;
+    }
+
+    // Index of the item with this exact name, or -1.
+    long find(string_view name) {
+        if (fixedFind) return fixedFind(name);
+        if (indexesStale) buildIndexes();
+        auto it = byName.find(name);
+        return it == byName.end() ? -1L : static_cast<long>(it->second);
+    }
+
+    int categoryId(string_view name) const {
+        for (size_t c = 0; c < categories.size(); ++c) {
+            if (categories[c] == name) return static_cast<int>(c);
+        }
+        return -1;
+    }
+
+    // Single entry point for stock movements: a sale is (-q, +q), a return
+    // (+q, -q). Keeps the in-stock bitmap and popularity order current; each
+    // unit of sold moves the item to the edge of its run of equal counts,
+    // one swap however many items share the count.
+    void adjustStock(size_t idx, int deltaQty, int deltaSold) {
+        if (indexesStale) buildIndexes();
+        Item& it = items[idx];
+        const int before = it.qty;
+        it.qty += deltaQty;
+        it.sold += deltaSold;
+        bitAssign(inStock, idx, it.qty > 0);
+        stock.update(idx, InventoryTree::leaf(it.name, it.qty, it.sold));
+        if (it.qty <= 0 && before > 0) logEvent(Event::SoldOut, it.name);
+        else if (it.qty <= LOW_STOCK && before > LOW_STOCK) logEvent(Event::StockLow, it.name, it.qty);
+
+        for (int d = deltaSold; d > 0; --d) promote(static_cast<uint32_t>(idx));
+        for (int d = deltaSold; d < 0; ++d) demote(static_cast<uint32_t>(idx));
+    }
+
+    bool anyInStock(string_view category) {
+        if (indexesStale) buildIndexes();
+        int c = categoryId(category);
+        if (c < 0) return false;
+        for (uint32_t k = catSpan[c].first; k < catSpan[c].second; ++k) {
+            if (bitTest(inStock, byCatPrice[k])) return true;
+        }
+        return false;
+    }
+
+    // The category (or whole-menu) price index narrows candidates to one
+    // contiguous range by binary search; stock and diet are then tested on
+    // the bitmap and attribute array. For popularity order a narrow range is
+    // ranked directly, while a wide one is answered by walking the popularity
+    // index until `limit` matches are found. A walk that has cost as much as
+    // ranking would, because stock or diet reject most of what it visits,
+    // gives up and ranks the range.
+    void query(const MenuQuery& q, vector<Item*>& out) {
+        out.clear();
+        if (indexesStale) buildIndexes();
+
+        const uint32_t* ids = byPrice.data();
+        const double* keys = byPriceKey.data();
+        size_t n = byPrice.size();
+        int cat = -1;
+        if (!q.category.empty()) {
+            cat = categoryId(q.category);
+            if (cat < 0) return;
+            ids = byCatPrice.data() + catSpan[cat].first;
+            keys = byCatPriceKey.data() + catSpan[cat].first;
+            n = catSpan[cat].second - catSpan[cat].first;
+        }
+        const size_t lo = static_cast<size_t>(lower_bound(keys, keys + n, q.minPrice) - keys);
+        const size_t hi = static_cast<size_t>(upper_bound(keys, keys + n, q.maxPrice) - keys);
+        const size_t cap = q.limit ? q.limit : numeric_limits<size_t>::max();
+
+        auto accept = [&](uint32_t i) {
+            return (!q.inStockOnly || bitTest(inStock, i)) && q.diet.matches(attrs[i]);
+            };
+
+        if (q.sort == SortBy::Price) {
+            for (size_t k = lo; k < hi && out.size() < cap; ++k) {
+                if (accept(ids[k])) out.push_back(&items[ids[k]]);
+            }
+            return;
+        }
+
+        // Walking the popularity index visits about limit * n / range items;
+        // ranking the range costs about range. Pick the cheaper one.
+        const double range = static_cast<double>(hi - lo);
+        const bool walk = range * range > static_cast<double>(q.limit) * items.size();
+        if (q.sort == SortBy::Popularity && q.limit != 0 && walk) {
+            const size_t budget = hi - lo; // what ranking would cost; never past the end
+            size_t inRange = 0;
+            for (size_t k = 0; k < budget && out.size() < cap; ++k) {
+                uint32_t i = byPopularity[k];
+                if (cat >= 0 && catOf[i] != cat) continue;
+                if (items[i].price < q.minPrice || items[i].price > q.maxPrice) continue;
+                ++inRange;
+                if (accept(i)) out.push_back(&items[i]);
+            }
+            if (out.size() == cap || inRange == budget) return;
+            out.clear();
+        }
+
+        // rank key in the high half, item index in the low half: plain integer sort
+        scratch.clear();
+        {
+            MemScope scope(MemTag::MenuIndexes);
+            for (size_t k = lo; k < hi; ++k) {
+                uint32_t i = ids[k];
+                if (!accept(i)) continue;
+                uint64_t key = q.sort == SortBy::Popularity ? popPos[i] : i;
+                scratch.push_back((key << 32) | i);
+            }
+        }
+        const size_t take = min(cap, scratch.size());
+        if (take == scratch.size()) sort(scratch.begin(), scratch.end());
+        else partial_sort(scratch.begin(), scratch.begin() + take, scratch.end());
+        out.reserve(take);
+        for (size_t k = 0; k < take; ++k) out.push_back(&items[static_cast<uint32_t>(scratch[k])]);
+    }
+
+private:
+    bool indexesStale = true;
+    vector<string_view> categories;                 // distinct, first-seen order
+    vector<uint16_t> catOf;                         // category id per item
+    vector<uint32_t> byPrice, byCatPrice, byPopularity;
+    vector<double> byPriceKey, byCatPriceKey;       // prices in index order, for binary search
+    vector<pair<uint32_t, uint32_t>> catSpan;       // [begin, end) of each category in byCatPrice
+    vector<uint32_t> popPos;                        // position of each item in byPopularity
+    struct PopularityRun { int sold; uint32_t first, last; };
+    vector<PopularityRun> runs;                     // spans of equal sold in byPopularity; pooled
+    vector<uint32_t> freeRuns;                      // pool slots not in use
+    vector<uint32_t> runOf;                         // run of each item
+    vector<uint64_t> inStock;                       // bit per item: qty > 0
+    InventoryTree stock;
+    unordered_map<string_view, uint32_t> byName;
+    long (*fixedFind)(string_view) = nullptr;
+    deque<string> text;                             // storage behind interned names
+    vector<uint64_t> scratch;
+
+    // Price keys and category spans for the sorted price indexes.
+    void priceKeys() {
+        const size_t n = items.size();
+        byPriceKey.resize(n);
+        byCatPriceKey.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            byPriceKey[k] = items[byPrice[k]].price;
+            byCatPriceKey[k] = items[byCatPrice[k]].price;
+        }
+
+        // byCatPrice is grouped by category, so each category is one span
+        catSpan.assign(categories.size(), make_pair(0u, 0u));
+        for (size_t k = 0; k < n; ++k) {
+            auto& span = catSpan[catOf[byCatPrice[k]]];
+            if (span.first == span.second) span.first = static_cast<uint32_t>(k);
+            span.second = static_cast<uint32_t>(k + 1);
+        }
+    }
+
+    void swapPopularity(uint32_t a, uint32_t b) {
+        swap(byPopularity[a], byPopularity[b]);
+        popPos[byPopularity[a]] = a;
+        popPos[byPopularity[b]] = b;
+    }
+
+    uint32_t newRun(int sold, uint32_t at) {
+        const PopularityRun run{ sold, at, at };
+        if (freeRuns.empty()) {
+            runs.push_back(run);
+            return static_cast<uint32_t>(runs.size() - 1);
+        }
+        const uint32_t r = freeRuns.back();
+        freeRuns.pop_back();
+        runs[r] = run;
+        return r;
+    }
+
+    // One more sale for item i: swap it to the front of its run, where it
+    // joins the tail of the run above if that one has the new count.
+    void promote(uint32_t i) {
+        const uint32_t r = runOf[i];
+        const uint32_t at = runs[r].first;
+        const int sold = runs[r].sold + 1;
+        const bool alone = at == runs[r].last;
+        swapPopularity(popPos[i], at);
+        const uint32_t above = at > 0 ? runOf[byPopularity[at - 1]] : r;
+        if (above != r && runs[above].sold == sold) {
+            runs[above].last = at;
+            runOf[i] = above;
+        }
+        else if (alone) {
+            runs[r].sold = sold;
+            return;
+        }
+        else runOf[i] = newRun(sold, at);
+        if (alone) freeRuns.push_back(r);
+        else runs[r].first = at + 1;
+    }
+
+    // One sale fewer: the mirror image, through the back of the run.
+    void demote(uint32_t i) {
+        const uint32_t r = runOf[i];
+        const uint32_t at = runs[r].last;
+        const int sold = runs[r].sold - 1;
+        const bool alone = at == runs[r].first;
+        swapPopularity(popPos[i], at);
+        const uint32_t below = at + 1 < byPopularity.size() ? runOf[byPopularity[at + 1]] : r;
+        if (below != r && runs[below].sold == sold) {
+            runs[below].first = at;
+            runOf[i] = below;
+        }
+        else if (alone) {
+            runs[r].sold = sold;
+            return;
+        }
+        else runOf[i] = newRun(sold, at);
+        if (alone) freeRuns.push_back(r);
+        else runs[r].last = at - 1;
+    }
+};
+
+/* -------------------- Embedded Default Menu -------------------- */
+// The single-branch menu is read-only data: names are views into literals
+// and name -> index is a perfect hash whose seed the compiler searches for,
+// so loading it copies no text and builds no hash map.
+struct MenuEntry {
+    string_view name;
+    double price;
+    int qty;
+    string_view category;
+    AttrMask attrs;
+};
+
+constexpr MenuEntry DEFAULT_MENU[] = {
+    { "Cappuccino", 140.00, 20, "Beverages", ATTR_VEGETARIAN | ATTR_DAIRY | ATTR_CAFFEINE },
+    { "Latte", 150.00, 20, "Beverages", ATTR_VEGETARIAN | ATTR_DAIRY | ATTR_CAFFEINE },
+    { "Iced Americano", 120.00, 20, "Beverages", ATTR_VEGAN | ATTR_VEGETARIAN | ATTR_CAFFEINE },
+    { "Chocolate Milkshake", 190.00, 20, "Beverages", ATTR_VEGETARIAN | ATTR_DAIRY },
+    { "Blueberry Muffin", 75.00, 20, "Snacks", ATTR_VEGETARIAN | ATTR_GLUTEN | ATTR_DAIRY | ATTR_EGG },
+    { "Garlic Parmesan Toast", 95.00, 20, "Snacks", ATTR_VEGETARIAN | ATTR_GLUTEN | ATTR_DAIRY },
+    { "Glazed Donut Holes", 100.00, 20, "Snacks", ATTR_VEGETARIAN | ATTR_GLUTEN | ATTR_DAIRY | ATTR_EGG },
+    { "Chicken Wrap", 180.00, 20, "Meals", ATTR_GLUTEN },
+    { "Garlic Rice + Burger", 220.00, 20, "Meals", ATTR_GLUTEN },
+    { "Chicken Alfredo Pasta", 275.00, 20, "Meals", ATTR_GLUTEN | ATTR_DAIRY },
+    { "Chocolate Cake Slice", 130.00, 20, "Desserts", ATTR_VEGETARIAN | ATTR_GLUTEN | ATTR_DAIRY | ATTR_EGG },
+    { "Fruit Parfait", 110.00, 20, "Desserts", ATTR_VEGETARIAN | ATTR_DAIRY | ATTR_NUTS },
+    { "Tiramisu", 270.00, 20, "Desserts", ATTR_VEGETARIAN | ATTR_GLUTEN | ATTR_DAIRY | ATTR_EGG | ATTR_CAFFEINE },
+};
+constexpr size_t DEFAULT_MENU_SIZE = sizeof(DEFAULT_MENU) / sizeof(DEFAULT_MENU[0]);
+
+constexpr uint32_t seededHash(string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed; // FNV-1a
+    for (char c : s) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15); // fold high bits into the slot bits
+}
+
+// slot[hash & (Slots - 1)] holds index + 1, 0 for an empty slot.
+template <size_t Slots>
+struct PerfectHash {
+    uint32_t seed = 0;
+    uint8_t slot[Slots] = {};
+};
+
+template <size_t Slots, size_t N>
+constexpr PerfectHash<Slots> buildPerfectHash(const MenuEntry(&table)[N]) {
+    static_assert((Slots & (Slots - 1)) == 0 && N < Slots && N < 255, "slot table too small");
+    for (uint32_t seed = 1;; ++seed) {
+        PerfectHash<Slots> ph;
+        ph.seed = seed;
+        bool clash = false;
+        for (size_t i = 0; i < N && !clash; ++i) {
+            uint8_t& s = ph.slot[seededHash(table[i].name, seed) & (Slots - 1)];
+            clash = s != 0;
+            s = static_cast<uint8_t>(i + 1);
+        }
+        if (!clash) return ph;
+    }
+}
+
+constexpr PerfectHash<32> DEFAULT_MENU_INDEX = buildPerfectHash<32>(DEFAULT_MENU);
+
+// Index into DEFAULT_MENU, or -1: one hash, one load, one compare.
+constexpr long findDefaultItem(string_view name) {
+    uint8_t s = DEFAULT_MENU_INDEX.slot[seededHash(name, DEFAULT_MENU_INDEX.seed) & 31];
+    return s != 0 && DEFAULT_MENU[s - 1].name == name ? static_cast<long>(s - 1) : -1L;
+}
+
+static_assert(findDefaultItem("Cappuccino") == 0 && findDefaultItem("Tiramisu") == 12
+    && findDefaultItem("Espresso") == -1, "default menu index");
+
+// The unit price is taken when the line is made, so a later menu change
+// does not reprice an order already taken.
+struct OrderLine {
+    Item* item;
+    int quantity;
+    double price;
+
+    OrderLine(Item* i = nullptr, int q = 0) : item(i), quantity(q), price(i ? i->price : 0.0) {}
+    double subtotal() const { return (item ? price * quantity : 0.0); }
+};
+
+enum class OrderStatus : uint8_t { Placed, Preparing, Ready, PickedUp };
+const int ORDER_STATUS_COUNT = 4;
+const uint32_t NO_ORDER = 0xFFFFFFFFu;
+const uint32_t NO_TABLE = 0xFFFFFFFFu;
+
+const char* statusName(OrderStatus s) {
+    switch (s) {
+    case OrderStatus::Placed: return "Placed";
+    case OrderStatus::Preparing: return "Preparing";
+    case OrderStatus::Ready: return "Ready";
+    case OrderStatus::PickedUp: return "Picked up";
+    }
+    return "?";
+}
+
+class Order {
+public:
+    string customerName;
+    string dineOption;
+    vector<OrderLine> lines;
+    unsigned long long receiptNo = 0;
+    chrono::system_clock::time_point timestamp;
+
+    // Lifecycle, maintained by OrderTracker. The links are indices into
+    // allOrders so they survive the vector reallocating.
+    OrderStatus status = OrderStatus::Placed;
+    uint32_t statusPrev = NO_ORDER;
+    uint32_t statusNext = NO_ORDER;
+    chrono::steady_clock::time_point prepStartedAt;
+
+    // Wait-time estimate, filled in by WaitTimeEstimator at checkout
+    double estWorkSeconds = 0.0;
+    int etaMinutes = -1;
+
+    // Eat-In seating, when the café has --tables: 0 and NO_TABLE otherwise
+    int party = 0;
+    uint32_t table = NO_TABLE;
+
+    Order() {
+        timestamp = chrono::system_clock::now();
+    }
+
+    double total() const {
+        double t = 0.0;
+        for (const auto& l : lines) t += l.subtotal();
+        return t;
+    }
+
+    void printReceipt(ostream& out = cout) const {
+        time_t tt = chrono::system_clock::to_time_t(timestamp);
+
+        // portable localtime handling
+        tm local_tm{};
+#ifdef _WIN32
+        localtime_s(&local_tm, &tt);
+#else
+        localtime_r(&tt, &local_tm);
+#endif
+
+        char timebuf[64];
+        strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &local_tm);
+
+        out << Colors::TITLE << "\n=== James' Café Receipt ===" << Colors::RESET << "\n";
+        out << Colors::SUBTLE << "Receipt# " << receiptNo << "     " << timebuf << Colors::RESET << "\n";
+        out << Colors::MUTED << "Customer: " << customerName << "     (" << dineOption;
+        if (table != NO_TABLE) out << ", table " << table + 1;
+        out << ")" << Colors::RESET << "\n\n";
+        out << left << setw(30) << "Item" << setw(6) << "Qty" << setw(12) << "Subtotal" << "\n";
+        out << "-----------------------------------------------\n";
+        for (const auto& l : lines) {
+            out << left << setw(30);
+            if (l.item) out << l.item->name;
+            else out << "(unknown)";
+            out << setw(6) << l.quantity
+                << "₱ " << fixed << setprecision(2) << l.subtotal() << "\n";
+        }
+        out << "-----------------------------------------------\n";
+        out << Colors::HIGHL << "TOTAL: ₱ " << fixed << setprecision(2) << total() << Colors::RESET << "\n";
+        if (etaMinutes >= 0) {
+            out << Colors::ACCENT << "Estimated ready in ~" << etaMinutes
+                << (etaMinutes == 1 ? " minute" : " minutes") << Colors::RESET << "\n";
+        }
+        out << Colors::TITLE << "Thank you for choosing James' Café — come back soon! ☕\n\n" << Colors::RESET;
+    }
+};
+
+/* -------------------- Order Lifecycle -------------------- */
+// One intrusive list per status, threaded through the orders themselves:
+// tracking, advancing and looking up an order are O(1), and the board only
+// walks the first few entries of each list.
+class OrderTracker {
+public:
+    explicit OrderTracker(vector<Order>& orders) : orders(orders) {
+        MemScope scope(MemTag::OrderBoard);
+        byReceipt.reserve(1024);
+    }
+
+    void track(uint32_t idx) {
+        MemScope scope(MemTag::OrderBoard);
+        orders[idx].status = OrderStatus::Placed;
+        append(idx);
+        byReceipt[orders[idx].receiptNo] = idx;
+    }
+
+    // Moves the order to the next status; false if it was already picked up.
+    bool advance(uint32_t idx) {
+        Order& o = orders[idx];
+        if (o.status == OrderStatus::PickedUp) return false;
+        unlink(idx);
+        o.status = static_cast<OrderStatus>(static_cast<int>(o.status) + 1);
+        if (o.status == OrderStatus::Preparing) o.prepStartedAt = chrono::steady_clock::now();
+        append(idx);
+        return true;
+    }
+
+    uint32_t find(unsigned long long receiptNo) const {
+        auto it = byReceipt.find(receiptNo);
+        return it == byReceipt.end() ? NO_ORDER : it->second;
+    }
+
+    uint32_t oldest(OrderStatus s) const { return lists[static_cast<int>(s)].head; }
+    size_t count(OrderStatus s) const { return lists[static_cast<int>(s)].size; }
+
+    void renderBoard(size_t perColumn = 8) const {
+        screen() << Colors::TITLE << "\n=== Now Serving ===\n" << Colors::RESET;
+        renderColumn(OrderStatus::Ready, Colors::HIGHL, "READY FOR PICKUP", perColumn);
+        renderColumn(OrderStatus::Preparing, Colors::ACCENT, "PREPARING", perColumn);
+        renderColumn(OrderStatus::Placed, Colors::MUTED, "WAITING", perColumn);
+        screen() << "\n";
+    }
+
+private:
+    struct List {
+        uint32_t head = NO_ORDER;
+        uint32_t tail = NO_ORDER;
+        size_t size = 0;
+    };
+
+    vector<Order>& orders;
+    List lists[ORDER_STATUS_COUNT];
+    unordered_map<unsigned long long, uint32_t> byReceipt;
+
+    void append(uint32_t idx) {
+        Order& o = orders[idx];
+        List& l = lists[static_cast<int>(o.status)];
+        o.statusPrev = l.tail;
+        o.statusNext = NO_ORDER;
+        if (l.tail != NO_ORDER) orders[l.tail].statusNext = idx;
+        else l.head = idx;
+        l.tail = idx;
+        l.size++;
+    }
+
+    void unlink(uint32_t idx) {
+        Order& o = orders[idx];
+        List& l = lists[static_cast<int>(o.status)];
+        if (o.statusPrev != NO_ORDER) orders[o.statusPrev].statusNext = o.statusNext;
+        else l.head = o.statusNext;
+        if (o.statusNext != NO_ORDER) orders[o.statusNext].statusPrev = o.statusPrev;
+        else l.tail = o.statusPrev;
+        o.statusPrev = o.statusNext = NO_ORDER;
+        l.size--;
+    }
+
+    void renderColumn(OrderStatus s, Style color, const char* heading, size_t limit) const {
+        const List& l = lists[static_cast<int>(s)];
+        screen() << color << heading << " (" << l.size << ")" << Colors::RESET << "\n";
+        size_t shown = 0;
+        for (uint32_t i = l.head; i != NO_ORDER && shown < limit; i = orders[i].statusNext, ++shown) {
+            screen() << "  #" << orders[i].receiptNo << "  " << orders[i].customerName << "\n";
+        }
+        if (l.size > shown) screen() << Colors::MUTED << "  ... and " << (l.size - shown) << " more\n" << Colors::RESET;
+    }
+};
+
+/* -------------------- Wait-Time Estimation -------------------- */
+// Per-item prep time is an exponentially-weighted moving average learned
+// from completed orders. The kitchen backlog (estimated work of every order
+// not yet ready) is kept as a running sum, so a checkout's ETA costs one
+// pass over its own lines regardless of how many orders are queued.
+class WaitTimeEstimator {
+public:
+    explicit WaitTimeEstimator(const Menu& menu, double alpha = 0.2, int stations = 1)
+        : menu(menu), alpha(alpha), stations(stations > 0 ? stations : 1) {
+    }
+
+    // Adds the order to the backlog; returns seconds until it should be ready.
+    double onPlaced(Order& o) {
+        double ahead = backlog;
+        o.estWorkSeconds = estimateWork(o);
+        backlog += o.estWorkSeconds;
+        double eta = ahead / stations + o.estWorkSeconds;
+        o.etaMinutes = static_cast<int>(ceil(eta / 60.0));
+        return eta;
+    }
+
+    // The kitchen finished `o` after `seconds` of prep. The miss is spread
+    // over its items in proportion to their current estimates.
+    void onReady(const Order& o, double seconds) {
+        backlog -= o.estWorkSeconds;
+        if (backlog < 0.0) backlog = 0.0;
+
+        double predicted = estimateWork(o);
+        if (predicted <= 0.0 || seconds <= 0.0) return;
+        double ratio = seconds / predicted;
+        for (const auto& l : o.lines) {
+            if (!l.item) continue;
+            double& est = prepSeconds[menu.indexOf(l.item)];
+            est += alpha * (est * ratio - est);
+        }
+    }
+
+    double backlogSeconds() const { return backlog; }
+
+private:
+    const Menu& menu;
+    double alpha;
+    int stations;
+    double backlog = 0.0;
+    vector<double> prepSeconds; // per menu index; grows with the menu
+
+    static double defaultPrep(string_view category) {
+        if (category == "Beverages") return 180.0;
+        if (category == "Snacks") return 120.0;
+        if (category == "Meals") return 480.0;
+        if (category == "Desserts") return 90.0;
+        return 180.0;
+    }
+
+    double estimateWork(const Order& o) {
+        MemScope scope(MemTag::WaitTimes);
+        if (prepSeconds.size() < menu.size()) prepSeconds.reserve(menu.size());
+        while (prepSeconds.size() < menu.size()) {
+            prepSeconds.push_back(defaultPrep(menu.items[prepSeconds.size()].category));
+        }
+        double work = 0.0;
+        for (const auto& l : o.lines) {
+            if (l.item) work += prepSeconds[menu.indexOf(l.item)] * l.quantity;
+        }
+        return work;
+    }
+};
+
+/* -------------------- Table Seating -------------------- */
+// --tables 2x8,4x6,...: Eat-In parties get the smallest free table that
+// seats them. Tables sit in a max-tree sorted by size whose leaves hold a
+// table's seats while it is free and 0 while taken, so the best fit is the
+// leftmost leaf with enough seats: one walk down the tree. Seating sets
+// when the table should turn over (the order's ETA plus dining time), and
+// a min-heap of those times frees tables as the clock passes them. Both
+// are O(log n) per decision, however many tables the floor has.
+class TableSeating {
+public:
+    using Clock = chrono::steady_clock;
+
+    // "2x8,4x6,6x2": eight two-seaters, six four-seaters and two
+    // six-seaters, numbered from 1 in that order. False if malformed.
+    bool configure(const string& spec, int minutes) {
+        vector<Table> parsed;
+        const char* p = spec.c_str();
+        while (true) {
+            // digits 'x' digits, then ',' and the next part or the end
+            char* end;
+            if (!isdigit(static_cast<unsigned char>(*p))) return false;
+            const long seats = strtol(p, &end, 10);
+            if (*end != 'x' || !isdigit(static_cast<unsigned char>(end[1]))) return false;
+            const long count = strtol(end + 1, &end, 10);
+            if (seats < 1 || seats > 0xFFFF || count < 1 || count > 100000 - static_cast<long>(parsed.size())) return false;
+            Table t;
+            t.seats = static_cast<uint16_t>(seats);
+            parsed.insert(parsed.end(), static_cast<size_t>(count), t);
+            if (*end == '\0') break;
+            if (*end != ',') return false;
+            p = end + 1;
+        }
+
+        tables = std::move(parsed);
+        dine = max(minutes, 0);
+        bySize.resize(tables.size());
+        for (uint32_t t = 0; t < tables.size(); ++t) bySize[t] = t;
+        stable_sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) { return tables[a].seats < tables[b].seats; });
+        leafOf.resize(tables.size());
+        for (uint32_t k = 0; k < bySize.size(); ++k) leafOf[bySize[k]] = k;
+        leaves = 1;
+        while (leaves < tables.size()) leaves *= 2;
+        tree.assign(2 * leaves, 0);
+        for (size_t k = 0; k < bySize.size(); ++k) tree[leaves + k] = tables[bySize[k]].seats;
+        for (size_t k = leaves - 1; k > 0; --k) tree[k] = max(tree[2 * k], tree[2 * k + 1]);
+        due = decltype(due)();
+        freeTables = tables.size();
+        return true;
+    }
+
+    size_t size() const { return tables.size(); }
+    size_t freeCount() const { return freeTables; }
+    int largest() const { return tables.empty() ? 0 : tables[bySize.back()].seats; }
+    int seats(uint32_t table) const { return tables[table].seats; }
+    int dineMinutes() const { return dine; }
+
+    // Smallest free table for `party`, held for `order` until `freeAt`;
+    // NO_TABLE if none fits right now.
+    uint32_t seat(uint32_t order, int party, Clock::time_point freeAt) {
+        if (party < 1 || tree.empty() || tree[1] < party) return NO_TABLE;
+        size_t k = 1;
+        while (k < leaves) k = tree[2 * k] >= party ? 2 * k : 2 * k + 1;
+        const uint32_t t = bySize[k - leaves];
+        Table& tb = tables[t];
+        tb.order = order;
+        tb.party = static_cast<uint16_t>(party);
+        tb.freeAt = freeAt;
+        due.push(Due{ freeAt, t, tb.generation });
+        setLeaf(leafOf[t], 0);
+        freeTables--;
+        return t;
+    }
+
+    // Clears a table early; its pending timer entry goes stale.
+    bool release(uint32_t table) {
+        if (table >= tables.size() || tables[table].order == NO_ORDER) return false;
+        Table& tb = tables[table];
+        tb.order = NO_ORDER;
+        tb.generation++;
+        setLeaf(leafOf[table], tb.seats);
+        freeTables++;
+        return true;
+    }
+
+    // Frees every table whose turnover time has passed; returns how many.
+    size_t releaseDue(Clock::time_point now) {
+        size_t released = 0;
+        while (!due.empty() && due.top().at <= now) {
+            const Due d = due.top();
+            due.pop();
+            if (tables[d.table].generation == d.generation && release(d.table)) released++;
+        }
+        return released;
+    }
+
+    void renderFloor(const vector<Order>& orders, Clock::time_point now, size_t limit = 12) const {
+        screen() << Colors::TITLE << "\n=== Tables (" << freeTables << " of " << tables.size() << " free) ===\n"
+            << Colors::RESET;
+        for (size_t k = 0; k < bySize.size();) {
+            const uint16_t s = tables[bySize[k]].seats;
+            size_t total = 0, open = 0;
+            for (; k < bySize.size() && tables[bySize[k]].seats == s; ++k, ++total) open += tree[leaves + k] != 0;
+            screen() << "  " << s << (s == 1 ? " seat:  " : " seats: ") << open << " of " << total << " free\n";
+        }
+        size_t shown = 0, taken = tables.size() - freeTables;
+        for (uint32_t t = 0; t < tables.size() && shown < limit; ++t) {
+            const Table& tb = tables[t];
+            if (tb.order == NO_ORDER) continue;
+            const long long left = chrono::duration_cast<chrono::minutes>(tb.freeAt - now).count();
+            screen() << Colors::ACCENT << "  Table " << t + 1 << Colors::RESET << " (" << tb.seats << ")  #"
+                << orders[tb.order].receiptNo << "  " << orders[tb.order].customerName << ", party of " << tb.party
+                << Colors::MUTED << "  frees in ~" << max(left, 0LL) << " min" << Colors::RESET << "\n";
+            shown++;
+        }
+        if (taken > shown) screen() << Colors::MUTED << "  ... and " << (taken - shown) << " more seated\n" << Colors::RESET;
+    }
+
+private:
+    struct Table {
+        uint16_t seats = 0;
+        uint16_t party = 0;
+        uint32_t order = NO_ORDER;
+        uint32_t generation = 0; // bumped on release, so stale timers are ignored
+        Clock::time_point freeAt;
+    };
+    struct Due {
+        Clock::time_point at;
+        uint32_t table, generation;
+        bool operator>(const Due& o) const { return at > o.at; }
+    };
+
+    vector<Table> tables;    // by table number - 1
+    vector<uint32_t> bySize; // leaf order: tables by seats, then number
+    vector<uint32_t> leafOf;
+    vector<uint16_t> tree;   // max free seats; leaves at [leaves, 2 * leaves)
+    size_t leaves = 0;
+    size_t freeTables = 0;
+    int dine = 30;
+    priority_queue<Due, vector<Due>, greater<Due>> due;
+
+    void setLeaf(size_t k, uint16_t seats) {
+        k += leaves;
+        tree[k] = seats;
+        for (k /= 2; k > 0; k /= 2) tree[k] = max(tree[2 * k], tree[2 * k + 1]);
+    }
+};
+
+/* -------------------- Order Sketches -------------------- */
+// Fixed-size, mergeable summaries updated as orders commit: a day's (or a
+// branch's) sketch is a few KB, and chain-wide figures come from merging
+// sketches instead of rescanning orders.
+
+uint64_t hashString(string_view s) {
+    uint64_t h = 1469598103934665603ULL; // FNV-1a
+    for (unsigned char c : s) {
+        h ^= static_cast<uint64_t>(std::tolower(c));
+        h *= 1099511628211ULL;
+    }
+    // splitmix64 finalizer: FNV's high bits are weak for short keys
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+// Distinct-count estimate, ~0.8% standard error with 16K one-byte registers.
+class HyperLogLog {
+public:
+    static const int P = 14;
+    static const size_t M = size_t(1) << P;
+
+    HyperLogLog() : registers(M, 0) {}
+
+    void add(uint64_t hash) {
+        size_t idx = static_cast<size_t>(hash >> (64 - P));
+        uint64_t rest = (hash << P) | (uint64_t(1) << (P - 1)); // sentinel bounds the rank
+        uint8_t rank = 1;
+        while (!(rest & (uint64_t(1) << 63))) { rest <<= 1; ++rank; }
+        if (rank > registers[idx]) registers[idx] = rank;
+    }
+
+    void merge(const HyperLogLog& other) {
+        for (size_t i = 0; i < M; ++i) registers[i] = max(registers[i], other.registers[i]);
+    }
+
+    double estimate() const {
+        double sum = 0.0;
+        size_t zeros = 0;
+        for (uint8_t r : registers) {
+            sum += ldexp(1.0, -r);
+            if (r == 0) ++zeros;
+        }
+        const double m = static_cast<double>(M);
+        double e = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+        if (e <= 2.5 * m && zeros > 0) e = m * log(m / static_cast<double>(zeros)); // linear counting
+        return e;
+    }
+
+    vector<uint8_t> registers;
+};
+
+// Merging t-digest (k1 scale): accurate tails, bounded number of centroids.
+class TDigest {
+public:
+    explicit TDigest(double compression = 100.0) : compression(compression) {}
+
+    void add(double x, double w = 1.0) {
+        if (total == 0.0 || x < minValue) minValue = x;
+        if (total == 0.0 || x > maxValue) maxValue = x;
+        buffer.push_back(Centroid{ x, w });
+        total += w;
+        if (buffer.size() >= static_cast<size_t>(5 * compression)) flush();
+    }
+
+    void merge(const TDigest& other) {
+        if (other.total == 0.0) return;
+        if (total == 0.0 || other.minValue < minValue) minValue = other.minValue;
+        if (total == 0.0 || other.maxValue > maxValue) maxValue = other.maxValue;
+        buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+        buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+        total += other.total;
+        flush();
+    }
+
+    double count() const { return total; }
+
+    double quantile(double q) {
+        flush();
+        if (centroids.empty()) return 0.0;
+        if (centroids.size() == 1) return centroids[0].mean;
+        const double target = q * total;
+        double cum = 0.0;
+        for (size_t i = 0; i < centroids.size(); ++i) {
+            const Centroid& c = centroids[i];
+            double mid = cum + c.weight / 2.0;
+            if (target < mid) {
+                if (i == 0) return minValue + (c.mean - minValue) * (c.weight > 0 ? target / mid : 0.0);
+                const Centroid& p = centroids[i - 1];
+                double pmid = cum - p.weight / 2.0;
+                return p.mean + (c.mean - p.mean) * (target - pmid) / (mid - pmid);
+            }
+            cum += c.weight;
+        }
+        const Centroid& last = centroids.back();
+        double lmid = total - last.weight / 2.0;
+        return last.mean + (maxValue - last.mean) * (target - lmid) / max(total - lmid, 1e-12);
+    }
+
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    double compression;
+    double total = 0.0;
+    double minValue = 0.0;
+    double maxValue = 0.0;
+    vector<Centroid> centroids;
+    vector<Centroid> buffer;
+
+    void flush() {
+        if (buffer.empty()) return;
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        sort(buffer.begin(), buffer.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+        centroids.clear();
+        const double PI = 3.14159265358979323846;
+        auto k = [&](double q) { return compression / (2.0 * PI) * asin(2.0 * min(1.0, max(0.0, q)) - 1.0); };
+
+        double soFar = 0.0;
+        Centroid cur = buffer[0];
+        double kLeft = k(0.0);
+        for (size_t i = 1; i < buffer.size(); ++i) {
+            const Centroid& next = buffer[i];
+            double qRight = (soFar + cur.weight + next.weight) / total;
+            if (k(qRight) - kLeft <= 1.0) {
+                cur.mean += (next.mean - cur.mean) * next.weight / (cur.weight + next.weight);
+                cur.weight += next.weight;
+            }
+            else {
+                soFar += cur.weight;
+                kLeft = k(soFar / total);
+                centroids.push_back(cur);
+                cur = next;
+            }
+        }
+        centroids.push_back(cur);
+        buffer.clear();
+    }
+};
+
+struct OrderSketches {
+    HyperLogLog customers;
+    TDigest basketSize;  // units per order
+    TDigest ticketValue; // order total
+
+    void add(string_view customer, int units, double total) {
+        MemScope scope(MemTag::Sketches);
+        customers.add(hashString(customer));
+        basketSize.add(units);
+        ticketValue.add(total);
+    }
+
+    void merge(const OrderSketches& other) {
+        MemScope scope(MemTag::Sketches);
+        customers.merge(other.customers);
+        basketSize.merge(other.basketSize);
+        ticketValue.merge(other.ticketValue);
+    }
+
+    void print(ostream& out) {
+        out << "Distinct customers (est.): " << static_cast<long long>(customers.estimate() + 0.5) << "\n";
+        out << fixed << setprecision(1)
+            << "Basket size (units): p50 " << basketSize.quantile(0.5) << ", p95 " << basketSize.quantile(0.95) << "\n";
+        out << fixed << setprecision(2)
+            << "Ticket value: p50 ₱ " << ticketValue.quantile(0.5) << ", p95 ₱ " << ticketValue.quantile(0.95) << "\n";
+    }
+
+    // Binary form: "JCSK" v1, HLL registers, then each digest's header and
+    // centroids. Native little-endian, like every platform we ship on.
+    void serialize(string& out) {
+        basketSize.flush();
+        ticketValue.flush();
+        uint32_t version = 1;
+        out.append("JCSK", 4);
+        out.append(reinterpret_cast<const char*>(&version), sizeof(version));
+        out.append(reinterpret_cast<const char*>(customers.registers.data()), HyperLogLog::M);
+        for (TDigest* d : { &basketSize, &ticketValue }) {
+            uint64_t n = d->centroids.size();
+            double head[4] = { d->compression, d->total, d->minValue, d->maxValue };
+            out.append(reinterpret_cast<const char*>(head), sizeof(head));
+            out.append(reinterpret_cast<const char*>(&n), sizeof(n));
+            out.append(reinterpret_cast<const char*>(d->centroids.data()), n * sizeof(TDigest::Centroid));
+        }
+    }
+
+    // Reads one serialized sketch from [p, end), advancing p.
+    bool deserialize(const char*& p, const char* end) {
+        MemScope scope(MemTag::Sketches);
+        auto take = [&](void* dst, size_t n) {
+            if (static_cast<size_t>(end - p) < n) return false;
+            memcpy(dst, p, n);
+            p += n;
+            return true;
+        };
+        char magic[4];
+        uint32_t version = 0;
+        if (!take(magic, 4) || memcmp(magic, "JCSK", 4) != 0) return false;
+        if (!take(&version, sizeof(version)) || version != 1) return false;
+        if (!take(customers.registers.data(), HyperLogLog::M)) return false;
+        for (TDigest* d : { &basketSize, &ticketValue }) {
+            double head[4];
+            uint64_t n = 0;
+            if (!take(head, sizeof(head)) || !take(&n, sizeof(n)) || n > 100000) return false;
+            d->compression = head[0];
+            d->total = head[1];
+            d->minValue = head[2];
+            d->maxValue = head[3];
+            d->buffer.clear();
+            d->centroids.resize(static_cast<size_t>(n));
+            if (!take(d->centroids.data(), static_cast<size_t>(n) * sizeof(TDigest::Centroid))) return false;
+        }
+        return true;
+    }
+
+    bool save(const string& path) {
+        string bytes;
+        serialize(bytes);
+        ofstream f(path, ios::binary | ios::trunc);
+        f.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        return static_cast<bool>(f);
+    }
+
+    bool load(const string& path) {
+        ifstream f(path, ios::binary);
+        if (!f) return false;
+        string bytes((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        const char* p = bytes.data();
+        return deserialize(p, p + bytes.size());
+    }
+};
+
+/* -------------------- Work-Stealing Scheduler -------------------- */
+// Each worker owns a deque: it pushes and pops its own tasks at the back
+// (LIFO, cache-warm) while idle workers steal from the front of a random
+// victim (FIFO, oldest and usually largest work). Tasks submitted from a
+// worker stay on that worker, so a session's next step follows it around
+// unless someone idle takes it.
+class WorkStealingPool {
+public:
+    typedef function<void()> Task;
+
+    explicit WorkStealingPool(unsigned threads = 0, bool allowSteal = true)
+        : stealing(allowSteal) {
+        MemScope scope(MemTag::Pool);
+        if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(new Worker());
+        for (unsigned i = 0; i < threads; ++i) pool.emplace_back([this, i]() { run(i); });
+    }
+
+    ~WorkStealingPool() {
+        {
+            lock_guard<mutex> lk(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : pool) t.join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    void submit(Task task) {
+        MemScope scope(MemTag::Pool);
+        pending++;
+        unsigned w = (currentPool() == this && currentWorker() >= 0)
+            ? static_cast<unsigned>(currentWorker())
+            : nextWorker++ % size();
+        {
+            lock_guard<mutex> lk(workers[w]->m);
+            workers[w]->tasks.push_back(std::move(task));
+        }
+        queued++;
+        {
+            lock_guard<mutex> lk(sleepMutex);
+        }
+        // without stealing only the owner can run it, so wake everyone
+        if (stealing) wake.notify_one();
+        else wake.notify_all();
+    }
+
+    // Blocks until every submitted task, including ones spawned by tasks,
+    // has finished. Must not be called from a worker.
+    void wait() {
+        unique_lock<mutex> lk(sleepMutex);
+        idle.wait(lk, [this]() { return pending.load() == 0; });
+    }
+
+    // Splits [begin, end) recursively so idle workers steal large halves.
+    void parallelFor(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& fn) {
+        if (begin >= end) return;
+        if (grain == 0) grain = 1;
+        submit([this, begin, end, grain, &fn]() { splitRange(begin, end, grain, fn); });
+        wait();
+    }
+
+    static int currentWorker() { return workerIndex(); }
+
+private:
+    struct Worker {
+        mutex m;
+        deque<Task> tasks;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> pool;
+    bool stealing;
+    atomic<size_t> pending{ 0 };    // submitted, not yet finished
+    atomic<size_t> queued{ 0 };     // sitting in some deque
+    atomic<unsigned> nextWorker{ 0 };
+    mutex sleepMutex;
+    condition_variable wake, idle;
+    bool stopping = false;
+
+    static int& workerIndex() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    static WorkStealingPool*& currentPool() {
+        static thread_local WorkStealingPool* p = nullptr;
+        return p;
+    }
+
+    void splitRange(size_t begin, size_t end, size_t grain, const function<void(size_t, size_t)>& fn) {
+        while (end - begin > grain) {
+            size_t mid = begin + (end - begin) / 2;
+            submit([this, mid, end, grain, &fn]() { splitRange(mid, end, grain, fn); });
+            end = mid;
+        }
+        fn(begin, end);
+    }
+
+    bool hasLocal(unsigned w) {
+        lock_guard<mutex> lk(workers[w]->m);
+        return !workers[w]->tasks.empty();
+    }
+
+    bool popLocal(unsigned w, Task& out) {
+        lock_guard<mutex> lk(workers[w]->m);
+        if (workers[w]->tasks.empty()) return false;
+        out = std::move(workers[w]->tasks.back());
+        workers[w]->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned thief, Task& out, unsigned& seed) {
+        const unsigned n = size();
+        seed = seed * 1103515245u + 12345u;
+        unsigned start = (seed >> 16) % n;
+        for (unsigned k = 0; k < n; ++k) {
+            unsigned v = (start + k) % n;
+            if (v == thief) continue;
+            unique_lock<mutex> lk(workers[v]->m, try_to_lock);
+            if (!lk.owns_lock() || workers[v]->tasks.empty()) continue;
+            out = std::move(workers[v]->tasks.front());
+            workers[v]->tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run(unsigned w) {
+        workerIndex() = static_cast<int>(w);
+        currentPool() = this;
+        unsigned seed = w + 1;
+        while (true) {
+            Task task;
+            if (popLocal(w, task) || (stealing && steal(w, task, seed))) {
+                queued--;
+                task();
+                if (--pending == 0) {
+                    lock_guard<mutex> lk(sleepMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+            unique_lock<mutex> lk(sleepMutex);
+            wake.wait(lk, [this, w]() {
+                return stopping || (queued.load() > 0 && (stealing || hasLocal(w)));
+                });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+};
+
+/* -------------------- Journal Writer -------------------- */
+// Group commit for the journal and the generated archive. Appenders copy
+// their record into the open batch; one writer thread turns each batch
+// into a single write followed by a data sync, so every order waiting on
+// that batch shares one flush. Two batch buffers alternate: one fills
+// while the other is on its way to disk.
+//
+// On Linux the batch goes to io_uring as a WRITE_FIXED from a registered
+// buffer linked to an FSYNC(DATASYNC): one system call per batch. When
+// the kernel refuses io_uring (old kernel, seccomp), and on other
+// platforms, it is a plain positioned write plus fdatasync.
+
+#if JC_IO_URING
+// Just enough of io_uring for write+sync chains, over the raw system calls
+// (no liburing dependency).
+class UringQueue {
+public:
+    ~UringQueue() {
+        if (sqes) munmap(sqes, sqesBytes);
+        if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingBytes);
+        if (sqRing) munmap(sqRing, sqRingBytes);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+        if (ringFd < 0) return false;
+
+        sqRingBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sqRingBytes = cqRingBytes = max(sqRingBytes, cqRingBytes);
+        sqRing = mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) { sqRing = nullptr; return false; }
+        cqRing = single ? sqRing
+            : mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { cqRing = nullptr; return false; }
+        sqesBytes = p.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = static_cast<io_uring_sqe*>(s);
+
+        char* sq = static_cast<char*>(sqRing);
+        char* cq = static_cast<char*>(cqRing);
+        sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    bool registerBuffers(const iovec* bufs, unsigned n) {
+        return syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, bufs, n) == 0;
+    }
+
+    // Writes [data, data + n) at `offset` and syncs the file data, as one
+    // linked chain; bufIndex < 0 when the data is not in a registered buffer.
+    // Returns the bytes written (the sync is skipped by the kernel after a
+    // short write) or -errno.
+    long long writeAndSync(int fd, const char* data, size_t n, unsigned long long offset, int bufIndex, bool& synced) {
+        unsigned tail = *sqTail;
+        io_uring_sqe* w = &sqes[tail & sqMask];
+        memset(w, 0, sizeof(*w));
+        w->opcode = bufIndex >= 0 ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        w->fd = fd;
+        w->addr = reinterpret_cast<unsigned long long>(data);
+        w->len = static_cast<unsigned>(n);
+        w->off = offset;
+        w->buf_index = static_cast<uint16_t>(bufIndex >= 0 ? bufIndex : 0);
+        w->flags = IOSQE_IO_LINK;
+        w->user_data = 1;
+        sqArray[tail & sqMask] = tail & sqMask;
+
+        io_uring_sqe* f = &sqes[(tail + 1) & sqMask];
+        memset(f, 0, sizeof(*f));
+        f->opcode = IORING_OP_FSYNC;
+        f->fd = fd;
+        f->fsync_flags = IORING_FSYNC_DATASYNC;
+        f->user_data = 2;
+        sqArray[(tail + 1) & sqMask] = (tail + 1) & sqMask;
+        __atomic_store_n(sqTail, tail + 2, __ATOMIC_RELEASE);
+
+        long long written = -EIO;
+        synced = false;
+        unsigned submitted = 2, reaped = 0;
+        while (reaped < 2) {
+            long r = syscall(__NR_io_uring_enter, ringFd, submitted, 2 - reaped, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR) return -errno;
+            if (r >= 0) submitted = 0;
+            unsigned head = *cqHead;
+            while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& c = cqes[head & cqMask];
+                if (c.user_data == 1) written = c.res;
+                else synced = c.res == 0;
+                ++head;
+                ++reaped;
+            }
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        }
+        return written;
+    }
+
+private:
+    int ringFd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingBytes = 0, cqRingBytes = 0, sqesBytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned sqMask = 0, cqMask = 0;
+};
+#endif
+
+class JournalWriter {
+public:
+    static const size_t BATCH_BYTES = size_t(4) << 20;
+
+    ~JournalWriter() { close(); }
+
+    // allowUring = false forces the write + fdatasync path (benchmarks).
+    bool open(const string& path, bool truncate = false, bool allowUring = true) {
+        close();
+        MemScope scope(MemTag::Journal);
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : 0), 0644);
+        if (fd < 0) return false;
+        offset = static_cast<unsigned long long>(_lseeki64(fd, 0, SEEK_END));
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0) return false;
+        offset = static_cast<unsigned long long>(lseek(fd, 0, SEEK_END));
+#endif
+        for (auto& b : batches) {
+            b.clear();
+            b.reserve(BATCH_BYTES);
+        }
+        filling = 0;
+        appended = durable = 0;
+        failed = closing = false;
+        syncs = 0;
+#if JC_IO_URING
+        uring.reset();
+        if (allowUring) {
+            unique_ptr<UringQueue> q(new UringQueue());
+            iovec regs[2];
+            for (int i = 0; i < 2; ++i) {
+                registered[i] = batches[i].data();
+                regs[i].iov_base = batches[i].data();
+                regs[i].iov_len = batches[i].capacity();
+            }
+            if (q->setup(8) && q->registerBuffers(regs, 2)) uring = std::move(q);
+        }
+        backendName = uring ? "io_uring" : "write+fdatasync";
+#else
+        (void)allowUring;
+        backendName = "write+fdatasync";
+#endif
+        writer = thread([this]() { run(); });
+        return true;
+    }
+
+    bool isOpen() const { return fd >= 0; }
+
+    const char* backend() const { return backendName; }
+
+    // Queues one record; the returned sequence number becomes durable with
+    // the batch it landed in. Waits only when both buffers are full.
+    unsigned long long append(const char* data, size_t n) {
+        unique_lock<mutex> lk(m);
+        progress.wait(lk, [&]() {
+            return failed || batches[filling].empty() || batches[filling].size() + n <= BATCH_BYTES;
+            });
+        vector<char>& b = batches[filling];
+        b.insert(b.end(), data, data + n);
+        unsigned long long seq = ++appended;
+        work.notify_one();
+        return seq;
+    }
+
+    // False if the write or sync failed; the journal should be treated as lost.
+    bool waitDurable(unsigned long long seq) {
+        unique_lock<mutex> lk(m);
+        progress.wait(lk, [&]() { return failed || durable >= seq; });
+        return !failed;
+    }
+
+    void close() {
+        if (fd < 0) return;
+        {
+            lock_guard<mutex> lk(m);
+            closing = true;
+        }
+        work.notify_one();
+        if (writer.joinable()) writer.join();
+#if JC_IO_URING
+        uring.reset();
+#endif
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+
+    bool ok() const { return !failed; }
+    unsigned long long syncCount() const {
+        lock_guard<mutex> lk(m);
+        return syncs;
+    }
+
+private:
+    int fd = -1;
+    const char* backendName = "closed";
+    unsigned long long offset = 0;
+    vector<char> batches[2];
+    int filling = 0;
+    unsigned long long appended = 0, durable = 0, syncs = 0;
+    bool failed = false, closing = false;
+    mutable mutex m;
+    condition_variable work, progress;
+    thread writer;
+#if JC_IO_URING
+    unique_ptr<UringQueue> uring;
+    const char* registered[2] = { nullptr, nullptr };
+#endif
+
+    void run() {
+        unique_lock<mutex> lk(m);
+        while (true) {
+            work.wait(lk, [&]() { return closing || !batches[filling].empty(); });
+            if (batches[filling].empty()) break; // closing and drained
+            const int flushing = filling;
+            filling ^= 1;
+            const unsigned long long upTo = appended;
+            progress.notify_all(); // the other buffer is open for appends
+            lk.unlock();
+
+            bool okWrite = writeBatch(flushing);
+
+            lk.lock();
+            batches[flushing].clear();
+            ++syncs;
+            if (okWrite) durable = upTo;
+            else failed = true;
+            progress.notify_all();
+        }
+    }
+
+    bool writeBatch(int idx) {
+        const vector<char>& b = batches[idx];
+        const char* data = b.data();
+        size_t left = b.size();
+#if JC_IO_URING
+        if (uring) {
+            // a record larger than the batch size reallocates the buffer,
+            // which then is no longer the registered one
+            int reg = b.data() == registered[idx] ? idx : -1;
+            bool synced = false;
+            long long w = uring->writeAndSync(fd, data, left, offset, reg, synced);
+            if (w < 0) return false;
+            offset += static_cast<unsigned long long>(w);
+            if (static_cast<size_t>(w) == left && synced) return true;
+            data += w;
+            left -= static_cast<size_t>(w);
+        }
+#endif
+        while (left > 0) {
+#ifdef _WIN32
+            int w = _write(fd, data, static_cast<unsigned>(min<size_t>(left, INT_MAX)));
+#else
+            ssize_t w = pwrite(fd, data, left, static_cast<off_t>(offset));
+            if (w < 0 && errno == EINTR) continue;
+#endif
+            if (w <= 0) return false;
+            data += w;
+            left -= static_cast<size_t>(w);
+            offset += static_cast<unsigned long long>(w);
+        }
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#elif defined(__APPLE__)
+        return fsync(fd) == 0;
+#else
+        return fdatasync(fd) == 0;
+#endif
+    }
+};
+
+/* -------------------- Menu & Journal Files -------------------- */
+// Menu file: one item per line, tab-separated
+//   name <TAB> price <TAB> qty <TAB> category <TAB> attr,attr,...
+// Journal: one committed order per line, tab-separated
+//   receipt# <TAB> epoch ms <TAB> customer <TAB> dine option {<TAB> qty <TAB> item name}
+// Lines starting with '#' are comments in both.
+const char* const ATTR_TAGS[] = { "vegan", "vegetarian", "gluten", "nuts", "dairy", "egg", "caffeine" };
+const int ATTR_TAG_COUNT = static_cast<int>(sizeof(ATTR_TAGS) / sizeof(ATTR_TAGS[0]));
+
+string formatAttrs(AttrMask a) {
+    string out;
+    for (int b = 0; b < ATTR_TAG_COUNT; ++b) {
+        if (!(a & (1u << b))) continue;
+        if (!out.empty()) out += ',';
+        out += ATTR_TAGS[b];
+    }
+    return out;
+}
+
+AttrMask parseAttrs(const string& s) {
+    AttrMask a = 0;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == string::npos) comma = s.size();
+        string tag = s.substr(pos, comma - pos);
+        for (int b = 0; b < ATTR_TAG_COUNT; ++b) {
+            if (tag == ATTR_TAGS[b]) a |= static_cast<AttrMask>(1u << b);
+        }
+        pos = comma + 1;
+    }
+    return a;
+}
+
+void splitTabs(const string& line, vector<string>& fields) {
+    fields.clear();
+    size_t pos = 0;
+    while (true) {
+        size_t tab = line.find('\t', pos);
+        fields.push_back(line.substr(pos, tab == string::npos ? string::npos : tab - pos));
+        if (tab == string::npos) break;
+        pos = tab + 1;
+    }
+}
+
+bool loadMenuFile(const string& path, Menu& menu, string& error) {
+    ifstream in(path);
+    if (!in) { error = "cannot open " + path; return false; }
+    string line;
+    vector<string> f;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        splitTabs(line, f);
+        if (f.size() < 4) { error = path + ":" + to_string(lineNo) + ": expected name, price, qty, category"; return false; }
+        blankSeparators(f[0]);
+        blankSeparators(f[3]);
+        menu.add(Item(menu.intern(f[0]), atof(f[1].c_str()), atoi(f[2].c_str()), menu.intern(f[3])),
+            f.size() > 4 ? parseAttrs(f[4]) : 0);
+    }
+    menu.buildIndexes();
+    return true;
+}
+
+void appendMenuRecord(string& out, const Item& it, AttrMask attrs) {
+    char price[32];
+    snprintf(price, sizeof(price), "%.2f", it.price);
+    out += it.name; out += '\t';
+    out += price; out += '\t';
+    out += to_string(it.qty); out += '\t';
+    out += it.category; out += '\t';
+    out += formatAttrs(attrs); out += '\n';
+}
+
+// Record builder shared by the app and the data generator.
+void journalBegin(string& out, unsigned long long receiptNo, unsigned long long epochMs,
+    string_view customer, string_view dine) {
+    appendUnsigned(out, receiptNo); out += '\t';
+    appendUnsigned(out, epochMs); out += '\t';
+    out += customer; out += '\t';
+    out += dine;
+}
+
+void journalLine(string& out, int qty, string_view item) {
+    out += '\t';
+    appendUnsigned(out, static_cast<unsigned long long>(qty));
+    out += '\t';
+    out += item;
+}
+
+void appendJournalRecord(string& out, const Order& o) {
+    unsigned long long ms = static_cast<unsigned long long>(
+        chrono::duration_cast<chrono::milliseconds>(o.timestamp.time_since_epoch()).count());
+    journalBegin(out, o.receiptNo, ms, o.customerName, o.dineOption);
+    for (const auto& l : o.lines) {
+        if (l.item) journalLine(out, l.quantity, l.item->name);
+    }
+    out += '\n';
+}
+
+/* ---- Journal segments ---- */
+// The journal is a series of segments, <path>.000001, <path>.000002, ...
+// The active one takes text records; once it reaches the segment size it
+// is sealed with a binary footer:
+//   "JCSF" | u32 version | u64 orders | u64 payload bytes | u32 crc32c(payload)
+//   | u32 item count | { u16 name length, name, i64 sold }... | sketches
+//   | u32 footer bytes | "JCSE"
+// Sealing also replaces the text by compressed blocks (see Journal
+// blocks), unless compression is off. Recovery checks a sealed segment's
+// checksum and applies its footer without parsing a record. A legacy single-file journal at <path> is
+// still read, split into ranges that are parsed in parallel.
+const size_t SEGMENT_BYTES = size_t(8) << 20;
+const size_t REPLAY_RANGE_BYTES = size_t(8) << 20;
+
+// CRC-32C, slicing-by-8: checksums a segment at memory speed on any CPU.
+uint32_t crc32c(const char* data, size_t n, uint32_t crc = 0) {
+    struct Tables {
+        uint32_t t[8][256];
+        Tables() {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0x82F63B78u & (0u - (c & 1u)));
+                t[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; ++i) {
+                for (int k = 1; k < 8; ++k) t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    };
+    static const Tables tables;
+    const auto& t = tables.t;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    while (n--) crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return ~crc;
+}
+
+string segmentPath(const string& base, unsigned n) {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%06u", n);
+    return base + suffix;
+}
+
+bool fileExists(const string& path) { return static_cast<bool>(ifstream(path, ios::binary)); }
+
+bool readFileRange(const string& path, unsigned long long from, size_t len, string& out) {
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    out.resize(len);
+    in.seekg(static_cast<streamoff>(from));
+    in.read(&out[0], static_cast<streamsize>(len));
+    out.resize(static_cast<size_t>(in.gcount()));
+    return true;
+}
+
+unsigned long long fileSize(const string& path) {
+    ifstream in(path, ios::binary | ios::ate);
+    return in ? static_cast<unsigned long long>(in.tellg()) : 0;
+}
+
+template <typename T>
+void appendPod(string& out, const T& v) { out.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+
+template <typename T>
+bool takePod(const char*& p, const char* end, T& v) {
+    if (static_cast<size_t>(end - p) < sizeof(v)) return false;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return true;
+}
+
+int parseQuantity(string_view field) {
+    int qty = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') break;
+        qty = qty * 10 + (c - '0');
+    }
+    return qty;
+}
+
+// Per-segment running totals: exactly what the footer records.
+struct SegmentTotals {
+    unsigned long long orders = 0;
+    unsigned long long payloadBytes = 0;
+    uint32_t crc = 0;
+    map<string, long long, less<>> sold; // by item name, sorted for a stable footer
+    OrderSketches sketches;
+
+    void addPayload(const char* data, size_t n) {
+        crc = crc32c(data, n, crc);
+        payloadBytes += n;
+    }
+
+    void addSale(string_view item, long long qty) {
+        auto it = sold.find(item);
+        if (it == sold.end()) it = sold.emplace(string(item), 0).first;
+        it->second += qty;
+    }
+
+    // One parsed journal record; prices come from `menu` for the sketches.
+    void addRecord(const vector<string_view>& f, Menu& menu) {
+        int units = 0;
+        double value = 0.0;
+        for (size_t k = 4; k + 1 < f.size(); k += 2) {
+            int qty = parseQuantity(f[k]);
+            units += qty;
+            addSale(f[k + 1], qty);
+            long idx = menu.find(f[k + 1]);
+            if (idx >= 0) value += menu.items[static_cast<size_t>(idx)].price * qty;
+        }
+        sketches.add(f[2], units, value);
+        orders++;
+    }
+
+    void appendFooter(string& out) {
+        const size_t start = out.size();
+        out.append("JCSF", 4);
+        appendPod(out, uint32_t(1));
+        appendPod(out, uint64_t(orders));
+        appendPod(out, uint64_t(payloadBytes));
+        appendPod(out, crc);
+        appendPod(out, static_cast<uint32_t>(sold.size()));
+        for (const auto& kv : sold) {
+            appendPod(out, static_cast<uint16_t>(kv.first.size()));
+            out += kv.first;
+            appendPod(out, static_cast<int64_t>(kv.second));
+        }
+        sketches.serialize(out);
+        appendPod(out, static_cast<uint32_t>(out.size() - start + 8));
+        out.append("JCSE", 4);
+    }
+};
+
+// Splits one journal line (without its newline) into tab-separated views.
+void splitTabViews(string_view line, vector<string_view>& fields) {
+    fields.clear();
+    size_t pos = 0;
+    while (true) {
+        size_t tab = line.find('\t', pos);
+        fields.push_back(line.substr(pos, tab == string_view::npos ? string_view::npos : tab - pos));
+        if (tab == string_view::npos) break;
+        pos = tab + 1;
+    }
+}
+
+bool wellFormedRecord(const vector<string_view>& f) {
+    return f.size() >= 4 && (f.size() - 4) % 2 == 0;
+}
+
+// Calls fn(fields) for every complete record in [p, end). Stops quietly at
+// a trailing line without its newline (a write that was never
+// acknowledged) or at a torn footer. A malformed record is counted in
+// `malformed` and skipped, or without it, fails the scan.
+template <typename Fn>
+bool forEachJournalRecord(const char* p, const char* end, Fn fn, size_t* malformed = nullptr) {
+    static thread_local vector<string_view> f;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!nl) break;
+        string_view line(p, static_cast<size_t>(nl - p));
+        p = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty() || line[0] == '#') continue;
+        if (line.size() >= 4 && memcmp(line.data(), "JCSF", 4) == 0) break;
+        splitTabViews(line, f);
+        if (!wellFormedRecord(f)) {
+            if (!malformed) return false;
+            ++*malformed;
+            continue;
+        }
+        fn(f);
+    }
+    return true;
+}
+
+/* ---- Journal blocks ---- */
+// A sealed segment may store its records as compressed blocks instead of
+// text:
+//   "JCSB" | u32 version | { u8 mode | u32 records | u32 raw bytes | u32 stored bytes | data }...
+// Each block holds up to BLOCK_RECORDS records. Customers, dine options
+// and item names are dictionary-coded: an id, and on first use in the
+// block the string itself. Receipt numbers and timestamps are deltas
+// from the previous record. Everything is a varint. The optional LZ stage
+// then compresses what repeats in the ids and deltas. A block containing
+// a record that would not decode back to the same bytes is stored as text.
+enum class JournalCompression : uint8_t { Off, Dictionary, DictionaryLz };
+enum BlockMode : uint8_t { BLOCK_TEXT = 0, BLOCK_DICT = 1, BLOCK_DICT_LZ = 2 };
+const uint32_t BLOCK_RECORDS = 65536;
+
+const char* compressionName(JournalCompression c) {
+    switch (c) {
+    case JournalCompression::Off: return "off";
+    case JournalCompression::Dictionary: return "dict";
+    case JournalCompression::DictionaryLz: return "lz";
+    }
+    return "?";
+}
+
+bool parseCompression(string_view s, JournalCompression& c) {
+    for (JournalCompression k : { JournalCompression::Off, JournalCompression::Dictionary, JournalCompression::DictionaryLz }) {
+        if (s == compressionName(k)) {
+            c = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+void putVarint(string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>(v | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+bool getVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+// Digits exactly as appendUnsigned writes them: no sign, no leading zero.
+bool canonicalNumber(string_view s, uint64_t& v) {
+    if (s.empty() || s.size() > 18 || (s.size() > 1 && s[0] == '0')) return false;
+    v = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+// LZ77 in LZ4's sequence layout: a token (literal length, match length
+// - 4), the literals, a 16-bit offset; lengths of 15 and up continue in
+// 255-valued bytes. Greedy, one hash probe per position.
+void lzPutLength(string& out, size_t n) {
+    for (; n >= 255; n -= 255) out += static_cast<char>(255);
+    out += static_cast<char>(n);
+}
+
+void lzCompress(const char* src, size_t n, string& out) {
+    const int HASH_BITS = 14;
+    vector<uint32_t> table(size_t(1) << HASH_BITS, 0); // position + 1; 0 is empty
+    size_t anchor = 0, i = 0;
+    auto emit = [&](size_t matchLen, size_t offset) {
+        const size_t lit = i - anchor;
+        const size_t extra = matchLen ? matchLen - 4 : 0;
+        out += static_cast<char>((min<size_t>(lit, 15) << 4) | min<size_t>(extra, 15));
+        if (lit >= 15) lzPutLength(out, lit - 15);
+        out.append(src + anchor, lit);
+        if (!matchLen) return;
+        out += static_cast<char>(offset & 0xFF);
+        out += static_cast<char>(offset >> 8);
+        if (extra >= 15) lzPutLength(out, extra - 15);
+    };
+    while (n >= 8 && i + 8 <= n) {
+        uint32_t v;
+        memcpy(&v, src + i, 4);
+        const uint32_t h = (v * 2654435761u) >> (32 - HASH_BITS);
+        const size_t cand = table[h];
+        table[h] = static_cast<uint32_t>(i + 1);
+        if (cand && i - (cand - 1) <= 65535 && memcmp(src + cand - 1, src + i, 4) == 0) {
+            const size_t from = cand - 1;
+            size_t len = 4;
+            while (i + len < n && src[from + len] == src[i + len]) ++len;
+            emit(len, i - from);
+            i += len;
+            anchor = i;
+        }
+        else {
+            ++i;
+        }
+    }
+    i = n;
+    emit(0, 0); // trailing literals
+}
+
+bool lzDecompress(const char* p, const char* end, size_t rawBytes, string& out) {
+    out.resize(rawBytes);
+    char* dst = &out[0];
+    size_t o = 0;
+    auto length = [&](size_t& len) {
+        while (p < end) {
+            uint8_t b = static_cast<uint8_t>(*p++);
+            len += b;
+            if (b != 255) return true;
+        }
+        return false;
+    };
+    while (p < end) {
+        const uint8_t token = static_cast<uint8_t>(*p++);
+        size_t lit = token >> 4;
+        if (lit == 15 && !length(lit)) return false;
+        if (static_cast<size_t>(end - p) < lit || rawBytes - o < lit) return false;
+        memcpy(dst + o, p, lit);
+        p += lit;
+        o += lit;
+        if (p == end) break;
+        if (end - p < 2) return false;
+        const size_t offset = static_cast<uint8_t>(p[0]) | (static_cast<size_t>(static_cast<uint8_t>(p[1])) << 8);
+        p += 2;
+        size_t len = token & 15;
+        if (len == 15 && !length(len)) return false;
+        len += 4;
+        if (offset == 0 || offset > o || rawBytes - o < len) return false;
+        if (offset >= len) memcpy(dst + o, dst + o - offset, len);
+        else for (size_t k = 0; k < len; ++k) dst[o + k] = dst[o + k - offset]; // overlapping run
+        o += len;
+    }
+    return o == rawBytes;
+}
+
+// Encodes the records of text [p, end) as blocks appended to `out`.
+void encodeJournalBlocks(const char* p, const char* end, JournalCompression mode, string& out) {
+    MemScope scope(MemTag::Journal);
+    out.append("JCSB", 4);
+    appendPod(out, uint32_t(1));
+    vector<string_view> f;
+    unordered_map<string_view, uint32_t> ids; // one dictionary for every string in the block
+    string block, packed;
+    while (p < end) {
+        const char* blockStart = p;
+        ids.clear();
+        block.clear();
+        uint32_t records = 0;
+        bool exact = true;
+        uint64_t prevReceipt = 0, prevMs = 0;
+        auto put = [&](string_view s) {
+            auto it = ids.find(s);
+            if (it != ids.end()) {
+                putVarint(block, it->second);
+                return;
+            }
+            const uint32_t id = static_cast<uint32_t>(ids.size());
+            putVarint(block, id);
+            putVarint(block, s.size());
+            block.append(s.data(), s.size());
+            ids.emplace(s, id);
+        };
+        for (; p < end && records < BLOCK_RECORDS; ++records) {
+            const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            string_view line(p, static_cast<size_t>((nl ? nl : end) - p));
+            p = nl ? nl + 1 : end;
+            if (!exact) continue;
+            splitTabViews(line, f);
+            uint64_t receipt = 0, ms = 0;
+            if (!nl || f.size() < 4 || (f.size() - 4) % 2 != 0 || !canonicalNumber(f[0], receipt)
+                || !canonicalNumber(f[1], ms) || f[3].find('\r') != string_view::npos) {
+                exact = false; // comment, blank, torn or hand-edited line
+                continue;
+            }
+            putVarint(block, zigzag(static_cast<int64_t>(receipt - prevReceipt - 1))); // receipts run in sequence
+            putVarint(block, zigzag(static_cast<int64_t>(ms - prevMs)));
+            prevReceipt = receipt;
+            prevMs = ms;
+            put(f[2]);
+            put(f[3]);
+            putVarint(block, (f.size() - 4) / 2);
+            for (size_t k = 4; k + 1 < f.size(); k += 2) {
+                uint64_t qty = 0;
+                if (!canonicalNumber(f[k], qty) || qty > INT_MAX || f[k + 1].find('\r') != string_view::npos) {
+                    exact = false;
+                    break;
+                }
+                putVarint(block, qty);
+                put(f[k + 1]);
+            }
+        }
+        uint8_t blockMode = BLOCK_DICT;
+        const char* data = block.data();
+        size_t raw = block.size(), stored = block.size();
+        if (!exact) {
+            blockMode = BLOCK_TEXT;
+            data = blockStart;
+            raw = stored = static_cast<size_t>(p - blockStart);
+        }
+        else if (mode == JournalCompression::DictionaryLz) {
+            packed.clear();
+            lzCompress(block.data(), block.size(), packed);
+            if (packed.size() < block.size()) {
+                blockMode = BLOCK_DICT_LZ;
+                data = packed.data();
+                stored = packed.size();
+            }
+        }
+        out += static_cast<char>(blockMode);
+        appendPod(out, records);
+        appendPod(out, static_cast<uint32_t>(raw));
+        appendPod(out, static_cast<uint32_t>(stored));
+        out.append(data, stored);
+    }
+}
+
+// Calls fn(fields) for every record of the block at `p`, advancing past
+// it. Fields point into the block, `scratch` and a per-record digit
+// buffer, and are valid only during the call. False if it is damaged.
+template <typename Fn>
+bool forEachBlockRecord(const char*& p, const char* end, string& scratch, Fn fn, size_t* malformed = nullptr) {
+    uint8_t mode = 0;
+    uint32_t records = 0, raw = 0, stored = 0;
+    if (!takePod(p, end, mode) || !takePod(p, end, records) || !takePod(p, end, raw) || !takePod(p, end, stored)
+        || static_cast<size_t>(end - p) < stored) {
+        return false;
+    }
+    const char* data = p;
+    const char* dataEnd = p + stored;
+    p = dataEnd;
+    if (mode == BLOCK_TEXT) return forEachJournalRecord(data, dataEnd, fn, malformed);
+    if (mode == BLOCK_DICT_LZ) {
+        if (!lzDecompress(data, dataEnd, raw, scratch)) return false;
+        data = scratch.data();
+        dataEnd = data + scratch.size();
+    }
+    else if (mode != BLOCK_DICT || raw != stored) {
+        return false;
+    }
+    vector<string_view> names, f;
+    auto get = [&](string_view& s) {
+        uint64_t id = 0, len = 0;
+        if (!getVarint(data, dataEnd, id) || id > names.size()) return false;
+        if (id == names.size()) {
+            if (!getVarint(data, dataEnd, len) || static_cast<uint64_t>(dataEnd - data) < len) return false;
+            names.emplace_back(data, static_cast<size_t>(len));
+            data += len;
+        }
+        s = names[static_cast<size_t>(id)];
+        return true;
+    };
+    // numbers are written back to digits in place, right to left per field
+    string digits;
+    auto number = [&](uint64_t v, size_t& at) {
+        size_t start = at;
+        do {
+            digits[--at] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v);
+        return string_view(digits.data() + at, start - at);
+    };
+    uint64_t receipt = 0, ms = 0;
+    for (uint32_t r = 0; r < records; ++r) {
+        uint64_t dReceipt = 0, dMs = 0, lines = 0, qty = 0;
+        string_view customer, dine, item;
+        if (!getVarint(data, dataEnd, dReceipt) || !getVarint(data, dataEnd, dMs) || !get(customer) || !get(dine)
+            || !getVarint(data, dataEnd, lines) || lines > static_cast<uint64_t>(dataEnd - data)) {
+            return false;
+        }
+        receipt += static_cast<uint64_t>(unzigzag(dReceipt)) + 1;
+        ms += static_cast<uint64_t>(unzigzag(dMs));
+        const size_t need = 20 * (static_cast<size_t>(lines) + 2);
+        if (digits.size() < need) digits.resize(need);
+        size_t at = digits.size();
+        f.clear();
+        f.push_back(number(receipt, at));
+        f.push_back(number(ms, at));
+        f.push_back(customer);
+        f.push_back(dine);
+        for (uint64_t l = 0; l < lines; ++l) {
+            if (!getVarint(data, dataEnd, qty) || qty > INT_MAX || !get(item)) return false;
+            f.push_back(number(qty, at));
+            f.push_back(item);
+        }
+        fn(f);
+    }
+    return data == dataEnd;
+}
+
+// Calls fn(fields) for every record of a segment payload, text or blocks.
+template <typename Fn>
+bool forEachStoredRecord(const char* p, const char* end, Fn fn, size_t* malformed = nullptr) {
+    if (end - p < 8 || memcmp(p, "JCSB", 4) != 0) return forEachJournalRecord(p, end, fn, malformed);
+    p += 4;
+    uint32_t version = 0;
+    if (!takePod(p, end, version) || version != 1) return false;
+    string scratch;
+    while (p < end) {
+        if (!forEachBlockRecord(p, end, scratch, fn, malformed)) return false;
+    }
+    return true;
+}
+
+// Atomically replaces `to` with `from`.
+bool replaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+// Writes records [text, text + n) as the sealed segment `path`: blocks
+// (text when `mode` is Off) plus footer, synced under a temporary name
+// and renamed into place, so a crash leaves the old file or the new one.
+bool writeSealedSegment(const string& path, const char* text, size_t n, SegmentTotals& totals, JournalCompression mode) {
+    MemScope scope(MemTag::Journal);
+    string file;
+    if (mode == JournalCompression::Off) file.assign(text, n);
+    else encodeJournalBlocks(text, text + n, mode, file);
+    totals.crc = crc32c(file.data(), file.size());
+    totals.payloadBytes = file.size();
+    totals.appendFooter(file);
+    const string tmp = path + ".tmp";
+    JournalWriter w;
+    if (w.open(tmp, true, false)) {
+        w.waitDurable(w.append(file.data(), file.size()));
+        w.close();
+        if (w.ok() && replaceFile(tmp, path)) return true;
+    }
+    remove(tmp.c_str());
+    return false;
+}
+
+// The sealed segment's footer, if `file` ends with one.
+bool findFooter(const string& file, const char*& footer, const char*& footerEnd, size_t& payloadBytes) {
+    if (file.size() < 12 || memcmp(file.data() + file.size() - 4, "JCSE", 4) != 0) return false;
+    uint32_t bytes = 0;
+    memcpy(&bytes, file.data() + file.size() - 8, 4);
+    if (bytes < 12 || bytes > file.size()) return false;
+    footer = file.data() + file.size() - bytes;
+    footerEnd = file.data() + file.size() - 8;
+    payloadBytes = file.size() - bytes;
+    return memcmp(footer, "JCSF", 4) == 0;
+}
+
+// A place in the journal: a segment (0 for the pre-segment file), the
+// number of its records before that place, and the byte offset there
+// while the segment is text.
+struct JournalPosition {
+    uint32_t segment = 1;
+    uint64_t record = 0; // records of `segment` already taken
+    uint64_t byte = 0;   // where they end, while the segment is text
+};
+
+// Appends committed orders to the active segment, rotating to a new one
+// at the segment size. Each append returns once the record is on disk.
+// Any number of registers may append at once: the totals are updated under
+// `guard`, the wait for the disk happens outside it, and a rotation waits
+// for those waits to finish before closing the writer. Compressing a full
+// segment happens on a background thread once the next one is open.
+class OrderJournal {
+public:
+    OrderJournal() = default;
+    OrderJournal(const OrderJournal&) = delete;
+    OrderJournal& operator=(const OrderJournal&) = delete;
+    ~OrderJournal() { finishSealing(); }
+
+    // Resumes the last segment if it was left open cleanly, else starts the
+    // next one.
+    bool open(const string& path, Menu& menu, size_t segmentBytes = SEGMENT_BYTES,
+        JournalCompression mode = JournalCompression::DictionaryLz) {
+        MemScope scope(MemTag::Journal);
+        finishSealing();
+        base = path;
+        limit = max<size_t>(segmentBytes, 4096);
+        compression = mode;
+        segment = 1;
+        while (fileExists(segmentPath(base, segment + 1))) ++segment;
+        totals = SegmentTotals();
+
+        const string last = segmentPath(base, segment);
+        string file;
+        if (readFileRange(last, 0, static_cast<size_t>(fileSize(last)), file) && !file.empty()) {
+            const char* footer;
+            const char* footerEnd;
+            size_t payload;
+            bool torn = file.back() != '\n' || findFooter(file, footer, footerEnd, payload)
+                || file.find("\nJCSF") != string::npos || file.compare(0, 4, "JCSF") == 0;
+            size_t malformed = 0;
+            bool parsed = !torn && forEachJournalRecord(file.data(), file.data() + file.size(),
+                [&](const vector<string_view>& f) { totals.addRecord(f, menu); }, &malformed);
+            if (parsed) totals.addPayload(file.data(), file.size());
+            else {
+                ++segment; // sealed, torn or unreadable: leave it to recovery
+                totals = SegmentTotals();
+            }
+        }
+        return writer.open(segmentPath(base, segment));
+    }
+
+    bool isOpen() const {
+        lock_guard<mutex> lk(guard);
+        return writer.isOpen() || broken;
+    }
+    bool ok() const {
+        lock_guard<mutex> lk(guard);
+        return writer.ok() && !broken;
+    }
+    unsigned long long syncCount() const {
+        lock_guard<mutex> lk(guard);
+        return syncs + writer.syncCount();
+    }
+    const char* backend() const { return writer.backend(); }
+    unsigned activeSegment() const { return segment; }
+    const string& path() const { return base; }
+
+    // Returns once the record is on disk; checkouts that arrive together
+    // share one sync. False if the write or sync failed: the order is not
+    // on disk. `at`, if given, is set to where the record starts; it is
+    // left alone when no journal is kept.
+    bool append(const Order& o, JournalPosition* at = nullptr) {
+        MemScope scope(MemTag::Journal);
+        thread_local string record; // per register, reused across orders
+        record.clear();
+        appendJournalRecord(record, o);
+
+        unique_lock<mutex> lk(guard);
+        idle.wait(lk, [&]() { return !sealing; });
+        if (!writer.isOpen()) return !broken; // no journal kept, or the next segment could not be started
+        if (at) *at = JournalPosition{ segment, totals.orders, totals.payloadBytes };
+        totals.addPayload(record.data(), record.size());
+        totals.orders++;
+        int units = 0;
+        for (const auto& l : o.lines) {
+            if (!l.item) continue;
+            units += l.quantity;
+            totals.addSale(l.item->name, l.quantity);
+        }
+        totals.sketches.add(o.customerName, units, o.total());
+        const unsigned long long seq = writer.append(record.data(), record.size());
+        ++waiting;
+        lk.unlock();
+        const bool durable = writer.waitDurable(seq);
+        lk.lock();
+        --waiting;
+        if (!durable) fail();
+        if (totals.payloadBytes >= limit && !sealing) {
+            sealing = true;
+            idle.wait(lk, [&]() { return waiting == 0; });
+            seal();
+            sealing = false;
+            idle.notify_all();
+        }
+        else if (waiting == 0) idle.notify_all();
+        return durable;
+    }
+
+private:
+    string base;
+    size_t limit = SEGMENT_BYTES;
+    JournalCompression compression = JournalCompression::DictionaryLz;
+    unsigned segment = 1;
+    bool failureLogged = false;
+    bool broken = false; // sealing failed; ok() stays false after the writer is reopened
+    JournalWriter writer;
+    SegmentTotals totals;
+    unsigned long long syncs = 0; // of sealed segments
+    mutable mutex guard;
+    condition_variable idle;
+    size_t waiting = 0; // appenders waiting for the disk
+    bool sealing = false;
+    thread sealer;      // compressing the last full segment, if joinable
+
+    // Off: the footer goes after the text. Otherwise the full segment is
+    // handed to `sealer` and the next one opened at once; the text is read
+    // back and replaced by its blocks there. If that fails the segment
+    // stays as text, which recovery parses. Called under `guard` with no
+    // appender waiting.
+    void seal() {
+        if (compression == JournalCompression::Off) {
+            string footer;
+            totals.appendFooter(footer);
+            if (!writer.waitDurable(writer.append(footer.data(), footer.size()))) fail();
+            syncs += writer.syncCount();
+            writer.close();
+            logEvent(Event::SegmentSealed, {}, static_cast<int32_t>(totals.orders), 0, segment);
+        }
+        else {
+            syncs += writer.syncCount();
+            writer.close();
+            finishSealing(); // segments fill far slower than they compress; rarely waits
+            sealer = thread([path = segmentPath(base, segment), n = segment, t = std::move(totals),
+                mode = compression]() mutable {
+                MemScope scope(MemTag::Journal);
+                string text;
+                if (!readFileRange(path, 0, static_cast<size_t>(fileSize(path)), text)
+                    || !writeSealedSegment(path, text.data(), text.size(), t, mode)) {
+                    // no orders lost, but the segment is left without its footer
+                    logEvent(Event::JournalFailed, {}, 0, 0, n);
+                    cerr << "Journal: could not seal " << path << "; it stays as text\n";
+                }
+                logEvent(Event::SegmentSealed, {}, static_cast<int32_t>(t.orders), 0, n);
+                });
+        }
+        ++segment;
+        totals = SegmentTotals();
+        if (!writer.open(segmentPath(base, segment), true)) fail();
+    }
+
+    void finishSealing() {
+        if (sealer.joinable()) sealer.join();
+    }
+
+    void fail() {
+        broken = true;
+        if (!failureLogged) {
+            failureLogged = true;
+            logEvent(Event::JournalFailed, {}, 0, 0, segment);
+        }
+    }
+};
+
+// A journal split for parallel reading: the pre-segment file in ranges,
+// then each segment whole.
+struct JournalSpan {
+    string path;
+    unsigned long long begin = 0, end = 0; // parse range; unused for whole segments
+    bool whole = false;                     // read the whole file, use the footer if sealed
+};
+
+vector<JournalSpan> journalSpans(const string& path) {
+    vector<JournalSpan> spans;
+    if (fileExists(path)) {
+        const unsigned long long size = fileSize(path);
+        for (unsigned long long b = 0; b < size; b += REPLAY_RANGE_BYTES) {
+            spans.push_back(JournalSpan{ path, b, min<unsigned long long>(size, b + REPLAY_RANGE_BYTES), false });
+        }
+    }
+    for (unsigned n = 1; fileExists(segmentPath(path, n)); ++n) spans.push_back(JournalSpan{ segmentPath(path, n), 0, 0, true });
+    return spans;
+}
+
+// Reads a ranged span into `data`; its records start at data[start]. A
+// range owns the records that start inside it: skip the line the previous
+// range finishes, run past `end` to finish our last.
+void readJournalRange(const JournalSpan& s, string& data, size_t& start) {
+    const unsigned long long from = s.begin ? s.begin - 1 : 0;
+    readFileRange(s.path, from, static_cast<size_t>(s.end - from), data);
+    start = 0;
+    if (s.begin) {
+        size_t nl = data.find('\n');
+        start = nl == string::npos ? data.size() : nl + 1;
+    }
+    string tail;
+    for (unsigned long long at = s.end; !data.empty() && data.back() != '\n'; at += 4096) {
+        if (!readFileRange(s.path, at, 4096, tail) || tail.empty()) break;
+        size_t nl = tail.find('\n');
+        data.append(tail, 0, nl == string::npos ? tail.size() : nl + 1);
+    }
+}
+
+// Units sold per menu item over every recorded order. Returns the number of
+// orders, or -1 with `error` set. Sealed segments are verified and
+// counted from their footers; open segments and legacy files are parsed
+// in ranges. All of it runs in parallel, each worker summing into its own
+// arrays. The menu is only read.
+long long sumJournal(const string& path, Menu& menu, vector<long long>& sold, string& error,
+    OrderSketches* sketches = nullptr) {
+    sold.assign(menu.size(), 0);
+    const vector<JournalSpan> spans = journalSpans(path);
+    if (spans.empty()) return 0; // no journal yet: fresh day
+
+    menu.ensureIndexes(); // find() is read-only from here on
+    struct WorkerTotals {
+        vector<long long> sold;
+        OrderSketches sketches;
+        long long orders = 0;
+        size_t malformed = 0;
+    };
+    WorkStealingPool pool;
+    vector<WorkerTotals> workers(pool.size());
+    for (auto& w : workers) w.sold.assign(menu.size(), 0);
+    vector<string> errors(spans.size());
+
+    auto parse = [&](const char* p, const char* end, WorkerTotals& w) {
+        return forEachJournalRecord(p, end, [&](const vector<string_view>& f) {
+            int units = 0;
+            double value = 0.0;
+            for (size_t k = 4; k + 1 < f.size(); k += 2) {
+                int qty = parseQuantity(f[k]);
+                units += qty;
+                long idx = menu.find(f[k + 1]);
+                if (idx < 0) continue; // item since removed from the menu
+                w.sold[static_cast<size_t>(idx)] += qty;
+                value += menu.items[static_cast<size_t>(idx)].price * qty;
+            }
+            if (sketches) w.sketches.add(f[2], units, value);
+            ++w.orders;
+            }, &w.malformed);
+    };
+
+    pool.parallelFor(0, spans.size(), 1, [&](size_t b, size_t e) {
+        WorkerTotals& w = workers[static_cast<size_t>(max(WorkStealingPool::currentWorker(), 0))];
+        string data;
+        for (size_t i = b; i < e; ++i) {
+            const JournalSpan& s = spans[i];
+            if (s.whole) {
+                readFileRange(s.path, 0, static_cast<size_t>(fileSize(s.path)), data);
+                const char* footer;
+                const char* footerEnd;
+                size_t payload;
+                if (!findFooter(data, footer, footerEnd, payload)) {
+                    if (data.compare(0, 4, "JCSB") == 0) errors[i] = s.path + ": damaged footer";
+                    else if (!parse(data.data(), data.data() + data.size(), w)) errors[i] = s.path + ": malformed record";
+                    continue;
+                }
+                const char* p = footer + 4;
+                uint32_t version = 0, crc = 0, items = 0;
+                uint64_t orders = 0, payloadBytes = 0;
+                bool ok = takePod(p, footerEnd, version) && version == 1 && takePod(p, footerEnd, orders)
+                    && takePod(p, footerEnd, payloadBytes) && takePod(p, footerEnd, crc) && takePod(p, footerEnd, items)
+                    && payloadBytes == payload;
+                if (ok && crc32c(data.data(), payload) != crc) {
+                    errors[i] = s.path + ": checksum mismatch";
+                    continue;
+                }
+                for (uint32_t k = 0; ok && k < items; ++k) {
+                    uint16_t len = 0;
+                    int64_t sold = 0;
+                    ok = takePod(p, footerEnd, len) && static_cast<size_t>(footerEnd - p) >= len;
+                    if (!ok) break;
+                    string_view name(p, len);
+                    p += len;
+                    ok = takePod(p, footerEnd, sold);
+                    long idx = menu.find(name);
+                    if (ok && idx >= 0) w.sold[static_cast<size_t>(idx)] += sold;
+                }
+                OrderSketches part;
+                ok = ok && part.deserialize(p, footerEnd);
+                if (!ok) {
+                    errors[i] = s.path + ": damaged footer";
+                    continue;
+                }
+                if (sketches) w.sketches.merge(part);
+                w.orders += static_cast<long long>(orders);
+                continue;
+            }
+            size_t start = 0;
+            readJournalRange(s, data, start);
+            if (!parse(data.data() + start, data.data() + data.size(), w)) {
+                errors[i] = s.path + ": malformed record near byte " + to_string(s.begin);
+            }
+        }
+        });
+
+    for (const auto& e : errors) {
+        if (!e.empty()) {
+            error = e;
+            return -1;
+        }
+    }
+    long long orders = 0;
+    size_t malformed = 0;
+    for (auto& w : workers) {
+        for (size_t i = 0; i < menu.size(); ++i) sold[i] += w.sold[i];
+        if (sketches) sketches->merge(w.sketches);
+        orders += w.orders;
+        malformed += w.malformed;
+    }
+    if (malformed) {
+        cerr << "Journal " << path << ": skipped " << malformed
+            << (malformed == 1 ? " malformed record\n" : " malformed records\n");
+    }
+    return orders;
+}
+
+// Applies every recorded order's stock/sold delta to the menu and rebuilds
+// the indexes once. Returns the number of orders replayed, or -1.
+long long replayJournal(const string& path, Menu& menu, string& error, OrderSketches* sketches = nullptr) {
+    vector<long long> sold;
+    long long orders = sumJournal(path, menu, sold, error, sketches);
+    if (orders <= 0) return orders;
+    for (size_t i = 0; i < menu.size(); ++i) {
+        menu.items[i].qty -= static_cast<int>(sold[i]);
+        menu.items[i].sold += static_cast<int>(sold[i]);
+    }
+    menu.buildIndexes();
+    return orders;
+}
+
+/* -------------------- Order Storage -------------------- */
+// Where a day's committed orders, stock levels and customer totals are
+// kept. The journal is the default and the record of truth for replay;
+// the in-memory store keeps nothing past the process; SQLite (built with
+// -DJC_SQLITE=1, linked with sqlite3) is for branches that want to query
+// their orders with SQL.
+struct StoredOrder {
+    unsigned long long receiptNo = 0, epochMs = 0;
+    string customer, dine;
+    vector<pair<string, int>> lines; // item, quantity
+    double total = 0.0;              // as charged; NaN if the store does not know
+};
+
+struct CustomerTotals {
+    long long orders = 0;
+    double spent = 0.0;              // NaN if any of the orders' totals is unknown
+    unsigned long long lastReceipt = 0;
+};
+
+class OrderStore {
+public:
+    virtual ~OrderStore() = default;
+    virtual const char* name() const = 0;
+    virtual bool ok() const = 0;
+
+    // Records a committed order along with the stock it left on its items.
+    // False if it could not be recorded.
+    virtual bool saveOrder(const Order& o) = 0;
+    // Ends the current batch: everything saved so far is durable.
+    virtual void commit() = 0;
+
+    virtual bool findOrder(unsigned long long receiptNo, StoredOrder& out) = 0;
+    virtual CustomerTotals customer(string_view name) = 0;
+    virtual long long unitsSold(string_view item) = 0;
+    virtual bool stockLevel(string_view item, int& qty) = 0;
+};
+
+unsigned long long orderEpochMs(const Order& o) {
+    return static_cast<unsigned long long>(
+        chrono::duration_cast<chrono::milliseconds>(o.timestamp.time_since_epoch()).count());
+}
+
+// Calls fn(fields) for every record of a journal in commit order: the
+// single pre-segment file, then each segment, sealed or open.
+template <typename Fn>
+bool forEachJournalOrder(const string& path, Fn fn) {
+    string data;
+    auto scan = [&](const string& p) {
+        if (!readFileRange(p, 0, static_cast<size_t>(fileSize(p)), data)) return false;
+        const char* footer;
+        const char* footerEnd;
+        size_t payload = data.size();
+        findFooter(data, footer, footerEnd, payload);
+        size_t malformed = 0;
+        return forEachStoredRecord(data.data(), data.data() + payload, fn, &malformed);
+    };
+    if (fileExists(path) && !scan(path)) return false;
+    for (unsigned n = 1; fileExists(segmentPath(path, n)); ++n) {
+        if (!scan(segmentPath(path, n))) return false;
+    }
+    return true;
+}
+
+class MemoryStore : public OrderStore {
+public:
+    const char* name() const override { return "memory"; }
+    bool ok() const override { return true; }
+
+    bool saveOrder(const Order& o) override {
+        MemScope scope(MemTag::Orders);
+        StoredOrder s;
+        s.receiptNo = o.receiptNo;
+        s.epochMs = orderEpochMs(o);
+        s.customer = o.customerName;
+        s.dine = o.dineOption;
+        s.total = o.total();
+        for (const auto& l : o.lines) {
+            if (!l.item) continue;
+            s.lines.emplace_back(string(l.item->name), l.quantity);
+            sold[s.lines.back().first] += l.quantity;
+            stock[s.lines.back().first] = l.item->qty;
+        }
+        CustomerTotals& c = customers[s.customer];
+        c.orders++;
+        c.spent += s.total;
+        c.lastReceipt = s.receiptNo;
+        byReceipt[s.receiptNo] = orders.size();
+        orders.push_back(std::move(s));
+        return true;
+    }
+
+    void commit() override {}
+
+    bool findOrder(unsigned long long receiptNo, StoredOrder& out) override {
+        auto it = byReceipt.find(receiptNo);
+        if (it == byReceipt.end()) return false;
+        out = orders[it->second];
+        return true;
+    }
+
+    CustomerTotals customer(string_view name) override {
+        auto it = customers.find(name);
+        return it == customers.end() ? CustomerTotals() : it->second;
+    }
+
+    long long unitsSold(string_view item) override {
+        auto it = sold.find(item);
+        return it == sold.end() ? 0 : it->second;
+    }
+
+    bool stockLevel(string_view item, int& qty) override {
+        auto it = stock.find(item);
+        if (it == stock.end()) return false;
+        qty = it->second;
+        return true;
+    }
+
+private:
+    deque<StoredOrder> orders;
+    unordered_map<unsigned long long, size_t> byReceipt;
+    map<string, CustomerTotals, less<>> customers;
+    map<string, long long, less<>> sold;
+    map<string, int, less<>> stock;
+};
+
+// Writes go to the day's OrderJournal. The first use scans the journal
+// once for where each receipt sits and what each customer and item adds
+// up to; saveOrder() keeps those current as it appends, so a point query
+// reads back one record (one block, once its segment is sealed) and a
+// total is a lookup. Records carry no prices,
+// and today's menu may not charge what an order did, so totals of orders
+// found by the scan are unknown (NaN); those saved since are exact. Stock
+// levels are the live menu's, which replay restores from the same journal.
+class JournalStore : public OrderStore {
+public:
+    JournalStore(OrderJournal& j, Menu& m) : journal(j), menu(m) {}
+
+    const char* name() const override { return "journal"; }
+    bool ok() const override { return !journal.isOpen() || journal.ok(); }
+
+    bool saveOrder(const Order& o) override {
+        load();
+        JournalPosition at;
+        at.segment = 0; // the journal only appends to segments; 0 means nothing was written
+        const bool saved = journal.append(o, &at);
+        if (!saved || at.segment == 0) return saved;
+        MemScope scope(MemTag::Orders);
+        add(o.receiptNo, at, o.customerName, o.total());
+        for (const auto& l : o.lines) {
+            if (l.item) addSold(l.item->name, l.quantity);
+        }
+        return true;
+    }
+
+    void commit() override {} // each append is already durable
+
+    bool findOrder(unsigned long long receiptNo, StoredOrder& out) override {
+        load();
+        auto it = byReceipt.find(receiptNo);
+        if (it == byReceipt.end()) return false;
+        // a segment sealed between our reads is read again as blocks
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            if (readRecord(it->second.at, receiptNo, out)) {
+                out.total = it->second.total;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    CustomerTotals customer(string_view name) override {
+        load();
+        auto it = customers.find(name);
+        return it == customers.end() ? CustomerTotals() : it->second;
+    }
+
+    long long unitsSold(string_view item) override {
+        load();
+        auto it = sold.find(item);
+        return it == sold.end() ? 0 : it->second;
+    }
+
+    bool stockLevel(string_view item, int& qty) override {
+        const long idx = menu.find(item);
+        if (idx < 0) return false;
+        qty = menu.items[static_cast<size_t>(idx)].qty;
+        return true;
+    }
+
+private:
+    struct Entry {
+        JournalPosition at;
+        double total = 0.0;
+    };
+
+    OrderJournal& journal;
+    Menu& menu;
+    bool loaded = false;
+    unordered_map<unsigned long long, Entry> byReceipt; // receipt numbers wrap: the latest wins
+    map<string, CustomerTotals, less<>> customers;
+    map<string, long long, less<>> sold;
+
+    static unsigned long long parseUnsigned(string_view s) {
+        unsigned long long v = 0;
+        for (char c : s) v = v * 10 + static_cast<unsigned>(c - '0');
+        return v;
+    }
+
+    void add(unsigned long long receiptNo, const JournalPosition& at, string_view customer, double total) {
+        byReceipt[receiptNo] = Entry{ at, total };
+        auto it = customers.find(customer);
+        if (it == customers.end()) it = customers.emplace(string(customer), CustomerTotals()).first;
+        it->second.orders++;
+        it->second.spent += total;
+        it->second.lastReceipt = receiptNo;
+    }
+
+    void addSold(string_view item, long long qty) {
+        auto it = sold.find(item);
+        if (it == sold.end()) it = sold.emplace(string(item), 0).first;
+        it->second += qty;
+    }
+
+    // Indexes what the journal held before this store first wrote to it.
+    void load() {
+        if (loaded || journal.path().empty()) return;
+        loaded = true;
+        MemScope scope(MemTag::Orders);
+        const string& base = journal.path();
+        if (fileExists(base)) loadFile(base, 0);
+        for (uint32_t n = 1; fileExists(segmentPath(base, n)); ++n) loadFile(segmentPath(base, n), n);
+    }
+
+    void loadFile(const string& path, uint32_t segment) {
+        string data;
+        if (!readFileRange(path, 0, static_cast<size_t>(fileSize(path)), data)) return;
+        const char* footer;
+        const char* footerEnd;
+        size_t payload = data.size();
+        findFooter(data, footer, footerEnd, payload);
+        JournalPosition at{ segment, 0, 0 };
+        auto take = [&](const vector<string_view>& f) {
+            add(parseUnsigned(f[0]), at, f[2], numeric_limits<double>::quiet_NaN());
+            for (size_t k = 4; k + 1 < f.size(); k += 2) addSold(f[k + 1], parseQuantity(f[k]));
+            ++at.record;
+        };
+        const char* p = data.data();
+        const char* end = p + payload;
+        size_t malformed = 0;
+        if (data.compare(0, 4, "JCSB") == 0) {
+            forEachStoredRecord(p, end, take, &malformed);
+            return;
+        }
+        // text: line by line, to know each record's offset
+        for (const char* line = p; line < end;) {
+            const char* nl = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+            if (!nl) break;
+            at.byte = static_cast<uint64_t>(line - p);
+            forEachJournalRecord(line, nl + 1, take, &malformed);
+            line = nl + 1;
+        }
+    }
+
+    // Reads the record at `at` into `out` if it is receipt `receiptNo`:
+    // from its offset while the segment is text, else by skipping whole
+    // blocks on their record counts and decoding the one that holds it.
+    bool readRecord(const JournalPosition& at, unsigned long long receiptNo, StoredOrder& out) {
+        const string path = at.segment ? segmentPath(journal.path(), at.segment) : journal.path();
+        bool found = false;
+        auto take = [&](const vector<string_view>& f) {
+            if (parseUnsigned(f[0]) != receiptNo) return;
+            found = true;
+            out = StoredOrder();
+            out.receiptNo = receiptNo;
+            out.epochMs = parseUnsigned(f[1]);
+            out.customer = string(f[2]);
+            out.dine = string(f[3]);
+            for (size_t k = 4; k + 1 < f.size(); k += 2) out.lines.emplace_back(string(f[k + 1]), parseQuantity(f[k]));
+        };
+        string data, chunk;
+        size_t malformed = 0;
+        if (!readFileRange(path, 0, 8, data)) return false;
+        if (data.compare(0, 4, "JCSB") != 0) {
+            data.clear();
+            size_t nl = string::npos;
+            for (uint64_t from = at.byte; nl == string::npos; from += chunk.size()) {
+                if (!readFileRange(path, from, 4096, chunk) || chunk.empty()) return false;
+                data += chunk;
+                nl = data.find('\n');
+            }
+            forEachJournalRecord(data.data(), data.data() + nl + 1, take, &malformed);
+            return found;
+        }
+        const size_t HEADER_BYTES = 13; // mode, records, raw and stored bytes
+        uint64_t first = 0;
+        string scratch;
+        for (uint64_t pos = 8; readFileRange(path, pos, HEADER_BYTES, chunk) && chunk.size() == HEADER_BYTES;) {
+            const char* h = chunk.data();
+            uint8_t mode = 0;
+            uint32_t records = 0, raw = 0, stored = 0;
+            takePod(h, h + HEADER_BYTES, mode);
+            takePod(h, h + HEADER_BYTES, records);
+            takePod(h, h + HEADER_BYTES, raw);
+            takePod(h, h + HEADER_BYTES, stored);
+            // text blocks may hold lines that are not records, so only coded ones are skipped by count
+            if (mode != BLOCK_TEXT && first + records <= at.record) {
+                first += records;
+                pos += HEADER_BYTES + stored;
+                continue;
+            }
+            if (!readFileRange(path, pos, HEADER_BYTES + stored, data) || data.size() != HEADER_BYTES + stored) return false;
+            const char* p = data.data();
+            uint64_t index = first;
+            if (!forEachBlockRecord(p, p + data.size(), scratch, [&](const vector<string_view>& f) {
+                if (index++ == at.record) take(f);
+                }, &malformed)) {
+                return false;
+            }
+            if (index > at.record) return found;
+            first = index;
+            pos += HEADER_BYTES + stored;
+        }
+        return false;
+    }
+};
+
+#if JC_SQLITE
+// One database file in WAL mode. Orders are written by prepared
+// statements inside a transaction that spans BATCH_ORDERS orders, at most
+// BATCH_MS old, or up to commit(), which the till calls whenever it goes
+// idle. A busy till pays for one WAL append per batch, not per order.
+// With synchronous=NORMAL a committed batch survives a crash of the
+// process; power loss can take back the last few.
+class SqliteStore : public OrderStore {
+public:
+    static const int BATCH_ORDERS = 64;
+    static const int BATCH_MS = 500;
+
+    ~SqliteStore() override { close(); }
+
+    // Creates the schema if needed. Items the database already tracks get
+    // their stock and sold counts from it; the rest are recorded as they
+    // stand in `menu`.
+    bool open(const string& path, Menu& menu, string& error) {
+        if (sqlite3_open(path.c_str(), &db) != SQLITE_OK) {
+            error = db ? sqlite3_errmsg(db) : "out of memory";
+            close();
+            return false;
+        }
+        // Receipt numbers wrap every ~11.6 days, so orders are keyed by
+        // their own id and a receipt looks up its latest order. Version 0
+        // databases keyed them by receipt and are converted in place.
+        const char* schema =
+            "CREATE TABLE IF NOT EXISTS orders(id INTEGER PRIMARY KEY, receipt INTEGER NOT NULL,"
+            " epoch_ms INTEGER NOT NULL, customer TEXT NOT NULL, dine TEXT NOT NULL, total REAL NOT NULL);"
+            "CREATE INDEX IF NOT EXISTS orders_receipt ON orders(receipt);"
+            "CREATE TABLE IF NOT EXISTS order_lines(order_id INTEGER NOT NULL, item TEXT NOT NULL,"
+            " qty INTEGER NOT NULL, subtotal REAL NOT NULL);"
+            "CREATE INDEX IF NOT EXISTS order_lines_order ON order_lines(order_id);"
+            "CREATE INDEX IF NOT EXISTS order_lines_item ON order_lines(item, qty);"
+            "CREATE TABLE IF NOT EXISTS customers(name TEXT PRIMARY KEY, orders INTEGER NOT NULL,"
+            " spent REAL NOT NULL, last_receipt INTEGER NOT NULL);"
+            "CREATE TABLE IF NOT EXISTS stock(item TEXT PRIMARY KEY, qty INTEGER NOT NULL, sold INTEGER NOT NULL);"
+            "PRAGMA user_version=1;";
+        const char* fromVersion0 =
+            "BEGIN;"
+            "ALTER TABLE orders RENAME TO orders_v0;"
+            "ALTER TABLE order_lines RENAME TO order_lines_v0;"
+            "DROP INDEX IF EXISTS order_lines_receipt;"
+            "DROP INDEX IF EXISTS order_lines_item;"
+            "CREATE TABLE orders(id INTEGER PRIMARY KEY, receipt INTEGER NOT NULL,"
+            " epoch_ms INTEGER NOT NULL, customer TEXT NOT NULL, dine TEXT NOT NULL, total REAL NOT NULL);"
+            "INSERT INTO orders SELECT receipt, receipt, epoch_ms, customer, dine, total FROM orders_v0;"
+            "CREATE TABLE order_lines(order_id INTEGER NOT NULL, item TEXT NOT NULL,"
+            " qty INTEGER NOT NULL, subtotal REAL NOT NULL);"
+            "INSERT INTO order_lines SELECT receipt, item, qty, subtotal FROM order_lines_v0 ORDER BY rowid;"
+            "DROP TABLE orders_v0;"
+            "DROP TABLE order_lines_v0;"
+            "PRAGMA user_version=1;"
+            "COMMIT;";
+        long long version = 0, legacy = 0;
+        bool ready = exec("PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", error)
+            && queryInt("PRAGMA user_version", version, error)
+            && queryInt("SELECT COUNT(*) FROM sqlite_master WHERE type = 'table' AND name = 'orders'", legacy, error);
+        if (ready && version == 0 && legacy && !exec(fromVersion0, error)) {
+            exec("ROLLBACK", error);
+            ready = false;
+        }
+        if (!ready || !exec(schema, error)
+            || !prepare(insertOrder, "INSERT INTO orders VALUES(NULL, ?1, ?2, ?3, ?4, ?5)", error)
+            || !prepare(insertLine, "INSERT INTO order_lines VALUES(?1, ?2, ?3, ?4)", error)
+            || !prepare(upsertCustomer, "INSERT INTO customers VALUES(?1, 1, ?2, ?3) ON CONFLICT(name) DO UPDATE SET"
+                " orders = orders + 1, spent = spent + excluded.spent, last_receipt = excluded.last_receipt", error)
+            || !prepare(upsertStock, "INSERT INTO stock VALUES(?1, ?2, ?3) ON CONFLICT(item) DO UPDATE SET"
+                " qty = excluded.qty, sold = excluded.sold", error)
+            || !prepare(selectOrder, "SELECT epoch_ms, customer, dine, total, id FROM orders WHERE receipt = ?1"
+                " ORDER BY id DESC LIMIT 1", error)
+            || !prepare(selectLines, "SELECT item, qty FROM order_lines WHERE order_id = ?1 ORDER BY rowid", error)
+            || !prepare(selectCustomer, "SELECT orders, spent, last_receipt FROM customers WHERE name = ?1", error)
+            || !prepare(selectSold, "SELECT COALESCE(SUM(qty), 0) FROM order_lines WHERE item = ?1", error)
+            || !prepare(selectStock, "SELECT qty, sold FROM stock WHERE item = ?1", error)) {
+            close();
+            return false;
+        }
+
+        bool restored = false;
+        begin();
+        for (auto& it : menu) {
+            bindText(selectStock, 1, it.name);
+            if (sqlite3_step(selectStock) == SQLITE_ROW) {
+                it.qty = sqlite3_column_int(selectStock, 0);
+                it.sold = sqlite3_column_int(selectStock, 1);
+                restored = true;
+            }
+            else saveStock(it);
+            sqlite3_reset(selectStock);
+        }
+        commit();
+        if (restored) menu.buildIndexes();
+        if (!healthy) error = sqlite3_errmsg(db);
+        return healthy;
+    }
+
+    const char* name() const override { return "sqlite"; }
+    bool ok() const override { return db && healthy; }
+
+    bool saveOrder(const Order& o) override {
+        if (!db) return false;
+        begin();
+        const double total = o.total();
+        sqlite3_bind_int64(insertOrder, 1, static_cast<sqlite3_int64>(o.receiptNo));
+        sqlite3_bind_int64(insertOrder, 2, static_cast<sqlite3_int64>(orderEpochMs(o)));
+        bindText(insertOrder, 3, o.customerName);
+        bindText(insertOrder, 4, o.dineOption);
+        sqlite3_bind_double(insertOrder, 5, total);
+        step(insertOrder);
+        const sqlite3_int64 id = sqlite3_last_insert_rowid(db);
+        for (const auto& l : o.lines) {
+            if (!l.item) continue;
+            sqlite3_bind_int64(insertLine, 1, id);
+            bindText(insertLine, 2, l.item->name);
+            sqlite3_bind_int(insertLine, 3, l.quantity);
+            sqlite3_bind_double(insertLine, 4, l.subtotal());
+            step(insertLine);
+            saveStock(*l.item);
+        }
+        bindText(upsertCustomer, 1, o.customerName);
+        sqlite3_bind_double(upsertCustomer, 2, total);
+        sqlite3_bind_int64(upsertCustomer, 3, static_cast<sqlite3_int64>(o.receiptNo));
+        step(upsertCustomer);
+        if (++batched >= BATCH_ORDERS || chrono::steady_clock::now() - batchStart >= chrono::milliseconds(BATCH_MS)) commit();
+        return healthy;
+    }
+
+    void commit() override {
+        if (!inTransaction) return;
+        string error;
+        if (!exec("COMMIT", error)) healthy = false;
+        inTransaction = false;
+        batched = 0;
+    }
+
+    bool findOrder(unsigned long long receiptNo, StoredOrder& out) override {
+        if (!db) return false;
+        sqlite3_bind_int64(selectOrder, 1, static_cast<sqlite3_int64>(receiptNo));
+        bool found = sqlite3_step(selectOrder) == SQLITE_ROW;
+        if (found) {
+            out = StoredOrder();
+            out.receiptNo = receiptNo;
+            out.epochMs = static_cast<unsigned long long>(sqlite3_column_int64(selectOrder, 0));
+            out.customer = columnText(selectOrder, 1);
+            out.dine = columnText(selectOrder, 2);
+            out.total = sqlite3_column_double(selectOrder, 3);
+            sqlite3_bind_int64(selectLines, 1, sqlite3_column_int64(selectOrder, 4));
+            while (sqlite3_step(selectLines) == SQLITE_ROW) {
+                out.lines.emplace_back(columnText(selectLines, 0), sqlite3_column_int(selectLines, 1));
+            }
+            sqlite3_reset(selectLines);
+        }
+        sqlite3_reset(selectOrder);
+        return found;
+    }
+
+    CustomerTotals customer(string_view name) override {
+        CustomerTotals c;
+        if (!db) return c;
+        bindText(selectCustomer, 1, name);
+        if (sqlite3_step(selectCustomer) == SQLITE_ROW) {
+            c.orders = sqlite3_column_int64(selectCustomer, 0);
+            c.spent = sqlite3_column_double(selectCustomer, 1);
+            c.lastReceipt = static_cast<unsigned long long>(sqlite3_column_int64(selectCustomer, 2));
+        }
+        sqlite3_reset(selectCustomer);
+        return c;
+    }
+
+    long long unitsSold(string_view item) override {
+        if (!db) return 0;
+        bindText(selectSold, 1, item);
+        long long units = sqlite3_step(selectSold) == SQLITE_ROW ? sqlite3_column_int64(selectSold, 0) : 0;
+        sqlite3_reset(selectSold);
+        return units;
+    }
+
+    bool stockLevel(string_view item, int& qty) override {
+        if (!db) return false;
+        bindText(selectStock, 1, item);
+        bool found = sqlite3_step(selectStock) == SQLITE_ROW;
+        if (found) qty = sqlite3_column_int(selectStock, 0);
+        sqlite3_reset(selectStock);
+        return found;
+    }
+
+private:
+    sqlite3* db = nullptr;
+    sqlite3_stmt* insertOrder = nullptr;
+    sqlite3_stmt* insertLine = nullptr;
+    sqlite3_stmt* upsertCustomer = nullptr;
+    sqlite3_stmt* upsertStock = nullptr;
+    sqlite3_stmt* selectOrder = nullptr;
+    sqlite3_stmt* selectLines = nullptr;
+    sqlite3_stmt* selectCustomer = nullptr;
+    sqlite3_stmt* selectSold = nullptr;
+    sqlite3_stmt* selectStock = nullptr;
+    bool inTransaction = false;
+    bool healthy = true;
+    int batched = 0;
+    chrono::steady_clock::time_point batchStart;
+
+    bool exec(const char* sql, string& error) {
+        char* message = nullptr;
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &message) == SQLITE_OK) return true;
+        error = message ? message : "sqlite error";
+        sqlite3_free(message);
+        return false;
+    }
+
+    // The first column of the first row of `sql`.
+    bool queryInt(const char* sql, long long& value, string& error) {
+        sqlite3_stmt* stmt = nullptr;
+        if (!prepare(stmt, sql, error)) return false;
+        const int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) value = sqlite3_column_int64(stmt, 0);
+        else if (rc != SQLITE_DONE) error = sqlite3_errmsg(db);
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_ROW || rc == SQLITE_DONE;
+    }
+
+    bool prepare(sqlite3_stmt*& stmt, const char* sql, string& error) {
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) return true;
+        error = sqlite3_errmsg(db);
+        return false;
+    }
+
+    void begin() {
+        if (inTransaction) return;
+        string error;
+        inTransaction = exec("BEGIN", error);
+        if (!inTransaction) healthy = false;
+        batchStart = chrono::steady_clock::now();
+    }
+
+    // Steps a write and readies it for the next bind.
+    void step(sqlite3_stmt* stmt) {
+        if (sqlite3_step(stmt) != SQLITE_DONE) healthy = false;
+        sqlite3_reset(stmt);
+    }
+
+    void saveStock(const Item& it) {
+        bindText(upsertStock, 1, it.name);
+        sqlite3_bind_int(upsertStock, 2, it.qty);
+        sqlite3_bind_int(upsertStock, 3, it.sold);
+        step(upsertStock);
+    }
+
+    static void bindText(sqlite3_stmt* stmt, int at, string_view s) {
+        sqlite3_bind_text(stmt, at, s.data(), static_cast<int>(s.size()), SQLITE_STATIC); // rebound before every step
+    }
+
+    static string columnText(sqlite3_stmt* stmt, int col) {
+        const unsigned char* p = sqlite3_column_text(stmt, col);
+        return p ? string(reinterpret_cast<const char*>(p), static_cast<size_t>(sqlite3_column_bytes(stmt, col))) : string();
+    }
+
+    void close() {
+        if (!db) return;
+        commit();
+        for (sqlite3_stmt* s : { insertOrder, insertLine, upsertCustomer, upsertStock, selectOrder, selectLines,
+            selectCustomer, selectSold, selectStock }) sqlite3_finalize(s);
+        sqlite3_close(db);
+        db = nullptr;
+    }
+};
+#endif
+
+/* -------------------- Menu Sync -------------------- */
+// HQ publishes the menu into a shared directory as numbered versions, and
+// branches pull only what changed since the version they hold:
+//   menu.version        latest version number, replaced last on publish
+//   menu.NNNNNN.delta   changes from version N-1 to N
+//   menu.snapshot       the whole menu at the latest version
+// Deltas and the snapshot are text, menu file records marked + (new or
+// changed) or - (withdrawn), after a header line:
+//   JCMD <TAB> 1 <TAB> version <TAB> base version <TAB> delta|full
+//   + <TAB> name <TAB> price <TAB> qty <TAB> category <TAB> attrs
+//   - <TAB> name
+// Stock belongs to the branch: qty is only used for items a branch is
+// adding (or listing again after a withdrawal).
+const unsigned long long MENU_SYNC_MAX_DELTAS = 64; // further behind, the snapshot is cheaper
+
+struct MenuChange {
+    string name, category;
+    double price = 0.0;
+    int qty = 0;
+    AttrMask attrs = 0;
+    bool withdrawn = false;
+};
+
+struct MenuDelta {
+    unsigned long long version = 0, base = 0;
+    bool full = false; // a snapshot: items it does not list are withdrawn
+    vector<MenuChange> changes;
+};
+
+string menuSyncPath(const string& dir, unsigned long long version) {
+    char name[40];
+    snprintf(name, sizeof(name), "menu.%06llu.delta", version);
+    return dir + "/" + name;
+}
+
+bool makeDirectory(const string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+#endif
+}
+
+// Removes an empty directory.
+bool removeDirectory(const string& path) {
+#ifdef _WIN32
+    return _rmdir(path.c_str()) == 0;
+#else
+    return rmdir(path.c_str()) == 0;
+#endif
+}
+
+// Replaces `path` with `data` so readers see the old file or the new one.
+bool writeFileAtomic(const string& path, const string& data) {
+    const string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        out.write(data.data(), static_cast<streamsize>(data.size()));
+        if (!out) return false;
+    }
+    return replaceFile(tmp, path);
+}
+
+long long priceCents(double price) { return llround(price * 100.0); }
+
+void appendMenuDelta(string& out, const MenuDelta& d) {
+    out += "JCMD\t1\t";
+    appendUnsigned(out, d.version); out += '\t';
+    appendUnsigned(out, d.base); out += '\t';
+    out += d.full ? "full\n" : "delta\n";
+    for (const auto& c : d.changes) {
+        if (c.withdrawn) {
+            out += "-\t"; out += c.name; out += '\n';
+            continue;
+        }
+        Item it(c.name, c.price, c.qty, c.category);
+        out += "+\t";
+        appendMenuRecord(out, it, c.attrs);
+    }
+}
+
+bool parseMenuDelta(const string& text, MenuDelta& d, string& error) {
+    d = MenuDelta();
+    vector<string_view> f;
+    size_t pos = 0;
+    bool header = true;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        if (nl == string::npos) { error = "truncated"; return false; }
+        string_view line(text.data() + pos, nl - pos);
+        pos = nl + 1;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        splitTabViews(line, f);
+        if (header) {
+            if (f.size() != 5 || f[0] != "JCMD" || f[1] != "1" || (f[4] != "delta" && f[4] != "full")) {
+                error = "not a menu delta";
+                return false;
+            }
+            d.version = strtoull(string(f[2]).c_str(), nullptr, 10);
+            d.base = strtoull(string(f[3]).c_str(), nullptr, 10);
+            d.full = f[4] == "full";
+            header = false;
+            continue;
+        }
+        MenuChange c;
+        if (f.size() == 2 && f[0] == "-") c.withdrawn = true;
+        else if (f.size() >= 5 && f[0] == "+") {
+            c.price = atof(string(f[2]).c_str());
+            c.qty = atoi(string(f[3]).c_str());
+            c.category = string(f[4]);
+            c.attrs = f.size() > 5 ? parseAttrs(string(f[5])) : 0;
+        }
+        else {
+            error = "malformed change: " + string(line);
+            return false;
+        }
+        c.name = string(f[1]);
+        d.changes.push_back(std::move(c));
+    }
+    if (header) { error = "empty"; return false; }
+    return true;
+}
+
+bool readMenuDelta(const string& path, MenuDelta& d, string& error, size_t* bytes = nullptr) {
+    string text;
+    if (!readFileRange(path, 0, static_cast<size_t>(fileSize(path)), text) || text.empty()) {
+        error = "cannot read " + path;
+        return false;
+    }
+    if (bytes) *bytes += text.size();
+    if (!parseMenuDelta(text, d, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+unsigned long long publishedMenuVersion(const string& dir) {
+    string text;
+    readFileRange(dir + "/menu.version", 0, 32, text);
+    return strtoull(text.c_str(), nullptr, 10);
+}
+
+// HQ side: publishes the menu file as the next version if it differs from
+// the last one. `delta` gets what changed; version 0 means nothing did.
+bool publishMenu(const string& menuPath, const string& dir, MenuDelta& delta, string& error) {
+    Menu next;
+    if (!loadMenuFile(menuPath, next, error)) return false;
+    if (!makeDirectory(dir)) {
+        error = "cannot create " + dir;
+        return false;
+    }
+    MenuDelta last;
+    const unsigned long long version = publishedMenuVersion(dir);
+    if (version && !readMenuDelta(dir + "/menu.snapshot", last, error)) return false;
+
+    unordered_map<string_view, const MenuChange*> before;
+    for (const auto& c : last.changes) before[c.name] = &c;
+    MenuDelta snapshot;
+    snapshot.version = version + 1;
+    snapshot.full = true;
+    delta = MenuDelta();
+    delta.version = version + 1;
+    delta.base = version;
+    for (size_t i = 0; i < next.size(); ++i) {
+        const Item& it = next.items[i];
+        MenuChange c;
+        c.name = string(it.name);
+        c.category = string(it.category);
+        c.price = it.price;
+        c.qty = it.qty;
+        c.attrs = next.attrs[i];
+        auto old = before.find(it.name);
+        if (old == before.end() || priceCents(old->second->price) != priceCents(c.price)
+            || old->second->category != c.category || old->second->attrs != c.attrs) delta.changes.push_back(c);
+        if (old != before.end()) before.erase(old);
+        snapshot.changes.push_back(std::move(c));
+    }
+    for (const auto& c : last.changes) {
+        if (!before.count(c.name)) continue; // still listed
+        MenuChange gone;
+        gone.name = c.name;
+        gone.withdrawn = true;
+        delta.changes.push_back(std::move(gone));
+    }
+    if (delta.changes.empty()) {
+        delta.version = 0;
+        return true;
+    }
+
+    // Delta and snapshot first; a branch only looks for them once the
+    // version file names them.
+    string text;
+    appendMenuDelta(text, delta);
+    string full;
+    appendMenuDelta(full, snapshot);
+    if (!writeFileAtomic(menuSyncPath(dir, delta.version), text) || !writeFileAtomic(dir + "/menu.snapshot", full)
+        || !writeFileAtomic(dir + "/menu.version", to_string(delta.version) + "\n")) {
+        error = "cannot write to " + dir;
+        return false;
+    }
+    return true;
+}
+
+// Branch side. fetch() reads what changed since the version held; apply()
+// lands the whole delta under the menu guard, so the menu is never seen
+// half-updated. Prices, attributes and withdrawals are written in place;
+// only a delta that adds items builds a new table aside and swaps it in.
+class MenuSync {
+public:
+    explicit MenuSync(string directory) : dir(std::move(directory)) {}
+
+    unsigned long long version() const { return held; }
+    size_t bytesRead() const { return bytes; }
+
+    // False with `error` empty when already current. Consecutive deltas are
+    // folded into one (the last change to an item wins); a gap, or being
+    // far behind, falls back to the snapshot.
+    bool fetch(MenuDelta& delta, string& error) {
+        error.clear();
+        const unsigned long long latest = publishedMenuVersion(dir);
+        if (latest <= held) return false;
+        if (held && latest - held <= MENU_SYNC_MAX_DELTAS) {
+            delta = MenuDelta();
+            delta.base = held;
+            unordered_map<string, size_t> at;
+            MenuDelta step;
+            bool complete = true;
+            for (unsigned long long v = held + 1; v <= latest && complete; ++v) {
+                complete = readMenuDelta(menuSyncPath(dir, v), step, error, &bytes) && step.base == v - 1 && !step.full;
+                for (auto& c : step.changes) {
+                    auto slot = at.emplace(c.name, delta.changes.size());
+                    if (slot.second) delta.changes.push_back(std::move(c));
+                    else delta.changes[slot.first->second] = std::move(c);
+                }
+                delta.version = v;
+            }
+            if (complete) return true;
+        }
+        if (!readMenuDelta(dir + "/menu.snapshot", delta, error, &bytes)) return false;
+        return delta.version > held;
+    }
+
+    // Returns how many items changed. Other registers selling meanwhile
+    // wait on the menu guard; their Item pointers stay valid unless the
+    // delta adds items.
+    size_t apply(Menu& menu, const MenuDelta& delta) {
+        size_t changed = 0;
+        {
+            lock_guard<mutex> lock(menu.guard);
+            menu.ensureIndexes();
+            bool adds = false;
+            for (const auto& c : delta.changes) adds = adds || (!c.withdrawn && menu.find(c.name) < 0);
+            if (!adds) {
+                vector<uint32_t> repriced;
+                changed = merge(menu, delta, menu.items, menu.attrs, &repriced);
+                menu.reindexPrices(repriced);
+                held = delta.version;
+                return changed;
+            }
+        }
+        menu.replaceItems([&](vector<Item>& items, vector<AttrMask>& attrs) {
+            changed = merge(menu, delta, items, attrs, nullptr);
+            return changed > 0;
+            });
+        held = delta.version;
+        return changed;
+    }
+
+private:
+    string dir;
+    unsigned long long held = 0;
+    size_t bytes = 0;
+    set<string, less<>> withdrawn; // by HQ; kept on the menu at zero stock so indexes and receipts stay valid
+
+    // Applies `delta` to items/attrs: the menu's own, with `repriced`
+    // collecting the items whose price indexes need redoing, or a copy of
+    // them (`repriced` null), which is indexed afresh.
+    size_t merge(Menu& menu, const MenuDelta& delta, vector<Item>& items, vector<AttrMask>& attrs,
+        vector<uint32_t>* repriced) {
+        // in place, stock moves through adjustStock() so its indexes follow
+        auto setQty = [&](size_t i, int qty) {
+            if (repriced) menu.adjustStock(i, qty - items[i].qty, 0);
+            else items[i].qty = qty;
+        };
+        // stock goes to zero the way a sale would take it there, SoldOut and all
+        auto withdraw = [&](size_t i) {
+            Item& it = items[i];
+            if (!withdrawn.insert(string(it.name)).second) return false;
+            if (it.qty > 0 && !repriced) logEvent(Event::SoldOut, it.name); // adjustStock() logs its own
+            setQty(i, 0);
+            return true;
+        };
+        vector<bool> listed(items.size(), !delta.full);
+        unordered_map<string_view, string_view> categories; // interned once per sync
+        auto category = [&](const string& name) {
+            auto it = categories.find(name);
+            if (it != categories.end()) return it->second;
+            for (const auto& item : items) {
+                if (item.category == name) return categories[item.category] = item.category;
+            }
+            string_view interned = menu.intern(name);
+            return categories[interned] = interned;
+        };
+
+        size_t changed = 0;
+        for (const auto& c : delta.changes) {
+            const long idx = menu.find(c.name);
+            if (c.withdrawn) {
+                if (idx >= 0 && withdraw(static_cast<size_t>(idx))) ++changed;
+                continue;
+            }
+            if (idx < 0) {
+                items.emplace_back(menu.intern(c.name), c.price, c.qty, category(c.category));
+                attrs.push_back(c.attrs);
+                ++changed;
+                continue;
+            }
+            const size_t i = static_cast<size_t>(idx);
+            Item& it = items[i];
+            listed[i] = true;
+            const bool moves = it.price != c.price || it.category != c.category;
+            bool differs = priceCents(it.price) != priceCents(c.price) || it.category != c.category
+                || attrs[i] != c.attrs;
+            it.price = c.price;
+            if (it.category != c.category) it.category = category(c.category);
+            attrs[i] = c.attrs;
+            if (moves && repriced) repriced->push_back(static_cast<uint32_t>(i));
+            if (withdrawn.erase(string(it.name))) {
+                setQty(i, c.qty);
+                differs = true;
+            }
+            if (differs) ++changed;
+        }
+        for (size_t i = 0; i < listed.size(); ++i) {
+            if (!listed[i] && withdraw(i)) ++changed;
+        }
+        return changed;
+    }
+};
+
+/* -------------------- Sales Shipping -------------------- */
+// A background thread that ships the branch's committed orders to HQ. It
+// tails the journal, so checkout never waits on it and nothing is lost
+// if the link, or the process, goes down: the journal still has every
+// order, and the shipper resumes from its checkpoint.
+//
+// Each batch becomes a chunk, numbered in sequence and written to a
+// local spool directory before it is sent:
+//   "JCSH" | u32 version | u64 seq | u16 branch length, branch
+//   | u32 from segment | u64 from record | u32 to segment | u64 to record
+//   | u64 to byte | u32 records | u32 crc32c(payload) | u64 payload bytes
+//   | payload (journal blocks, see Journal blocks)
+// A chunk covers journal records [from, to), where a record is counted
+// within its segment. Once the sink accepts a chunk, the checkpoint moves
+// past it and the spooled copy is deleted. After a crash, spooled chunks
+// are resent with the same sequence numbers and contents. Sinks store a
+// chunk under (branch, seq), so a resend replaces nothing and each order
+// reaches HQ exactly once.
+const uint32_t SHIPMENT_VERSION = 1;
+
+struct ShipmentHeader {
+    uint64_t seq = 0;
+    string branch;
+    JournalPosition from, to;
+    uint32_t records = 0;
+};
+
+void appendShipment(string& out, const ShipmentHeader& h, const string& payload) {
+    out.append("JCSH", 4);
+    appendPod(out, SHIPMENT_VERSION);
+    appendPod(out, h.seq);
+    appendPod(out, static_cast<uint16_t>(h.branch.size()));
+    out += h.branch;
+    appendPod(out, h.from.segment);
+    appendPod(out, h.from.record);
+    appendPod(out, h.to.segment);
+    appendPod(out, h.to.record);
+    appendPod(out, h.to.byte);
+    appendPod(out, h.records);
+    appendPod(out, crc32c(payload.data(), payload.size()));
+    appendPod(out, static_cast<uint64_t>(payload.size()));
+    out += payload;
+}
+
+// Checks the chunk and its checksum; `payload` is left pointing into it.
+bool readShipment(const string& chunk, ShipmentHeader& h, const char*& payload, const char*& payloadEnd) {
+    if (chunk.compare(0, 4, "JCSH") != 0) return false;
+    const char* p = chunk.data() + 4;
+    const char* end = chunk.data() + chunk.size();
+    uint32_t version = 0, crc = 0;
+    uint16_t len = 0;
+    uint64_t bytes = 0;
+    if (!takePod(p, end, version) || version != SHIPMENT_VERSION || !takePod(p, end, h.seq) || !takePod(p, end, len)
+        || static_cast<size_t>(end - p) < len) return false;
+    h.branch.assign(p, len);
+    p += len;
+    if (!takePod(p, end, h.from.segment) || !takePod(p, end, h.from.record) || !takePod(p, end, h.to.segment)
+        || !takePod(p, end, h.to.record) || !takePod(p, end, h.to.byte) || !takePod(p, end, h.records)
+        || !takePod(p, end, crc) || !takePod(p, end, bytes) || static_cast<uint64_t>(end - p) != bytes) return false;
+    payload = p;
+    payloadEnd = end;
+    return crc32c(p, static_cast<size_t>(bytes)) == crc;
+}
+
+bool validBranchName(string_view name) {
+    if (name.empty() || name.size() > 64) return false;
+    for (char c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_') return false;
+    }
+    return true;
+}
+
+// HQ side of both sinks: one file per (branch, seq). A chunk already
+// stored is acknowledged again and left alone.
+bool storeShipment(const string& dir, const string& chunk, ShipmentHeader& h, bool& duplicate, string& error) {
+    const char* payload;
+    const char* payloadEnd;
+    if (!readShipment(chunk, h, payload, payloadEnd) || !validBranchName(h.branch)) {
+        error = "damaged chunk";
+        return false;
+    }
+    char name[96];
+    snprintf(name, sizeof(name), "/%s.%010llu.chunk", h.branch.c_str(), static_cast<unsigned long long>(h.seq));
+    const string path = dir + name;
+    duplicate = fileExists(path);
+    if (duplicate) return true;
+    if (!makeDirectory(dir) || !writeFileAtomic(path, chunk)) {
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+class ChunkSink {
+public:
+    virtual ~ChunkSink() = default;
+    // True once HQ holds the chunk.
+    virtual bool deliver(const string& chunk, string& error) = 0;
+};
+
+// file:<dir>, e.g. a share HQ reads.
+class FileChunkSink : public ChunkSink {
+public:
+    explicit FileChunkSink(string directory) : dir(std::move(directory)) {}
+
+    bool deliver(const string& chunk, string& error) override {
+        ShipmentHeader h;
+        bool duplicate = false;
+        return storeShipment(dir, chunk, h, duplicate, error);
+    }
+
+private:
+    string dir;
+};
+
+/* ---- HTTP ---- */
+// Just enough HTTP/1.1 for one POST per connection, plain TCP, to a
+// receiver such as --receive-sales.
+#ifdef _WIN32
+typedef SOCKET SocketHandle;
+const SocketHandle NO_SOCKET = INVALID_SOCKET;
+void closeSocket(SocketHandle s) { closesocket(s); }
+bool socketsReady() {
+    static const bool ready = []() { WSADATA data; return WSAStartup(MAKEWORD(2, 2), &data) == 0; }();
+    return ready;
+}
+#else
+typedef int SocketHandle;
+const SocketHandle NO_SOCKET = -1;
+void closeSocket(SocketHandle s) { ::close(s); }
+bool socketsReady() { return true; }
+#endif
+
+void setSocketTimeout(SocketHandle s, int seconds) {
+#ifdef _WIN32
+    DWORD ms = static_cast<DWORD>(seconds * 1000);
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&ms), sizeof(ms));
+#else
+    timeval tv{ seconds, 0 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#ifdef SO_NOSIGPIPE
+    int on = 1; // no MSG_NOSIGNAL on BSD and macOS
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+#endif
+}
+
+// A peer that hung up mid-send fails the send instead of raising
+// SIGPIPE, which would kill the register.
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+bool sendAll(SocketHandle s, const char* p, size_t n) {
+    while (n) {
+        const int sent = static_cast<int>(send(s, p, static_cast<int>(min<size_t>(n, 1 << 20)), SEND_FLAGS));
+        if (sent <= 0) return false;
+        p += sent;
+        n -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// Reads a request or response head and, given its Content-Length, body.
+bool readHttpMessage(SocketHandle s, string& head, string& body) {
+    string data;
+    char buf[16384];
+    size_t headEnd = string::npos;
+    while (headEnd == string::npos) {
+        const int got = static_cast<int>(recv(s, buf, sizeof(buf), 0));
+        if (got <= 0 || data.size() > 65536) return false;
+        data.append(buf, static_cast<size_t>(got));
+        headEnd = data.find("\r\n\r\n");
+    }
+    head = data.substr(0, headEnd);
+    body = data.substr(headEnd + 4);
+    size_t length = 0;
+    string lower = head;
+    for (char& c : lower) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    const size_t at = lower.find("\r\ncontent-length:");
+    if (at != string::npos) length = strtoull(head.c_str() + at + 17, nullptr, 10);
+    if (length > 256u << 20) return false;
+    while (body.size() < length) {
+        const int got = static_cast<int>(recv(s, buf, sizeof(buf), 0));
+        if (got <= 0) return false;
+        body.append(buf, static_cast<size_t>(got));
+    }
+    body.resize(length);
+    return true;
+}
+
+// http://host[:port]/path
+class HttpChunkSink : public ChunkSink {
+public:
+    static bool parse(const string& url, string& host, string& port, string& path) {
+        if (url.compare(0, 7, "http://") != 0) return false;
+        const size_t slash = url.find('/', 7);
+        const string authority = url.substr(7, slash == string::npos ? string::npos : slash - 7);
+        path = slash == string::npos ? "/" : url.substr(slash);
+        const size_t colon = authority.rfind(':');
+        host = authority.substr(0, colon);
+        port = colon == string::npos ? "80" : authority.substr(colon + 1);
+        return !host.empty() && !port.empty();
+    }
+
+    HttpChunkSink(string h, string p, string target) : host(std::move(h)), port(std::move(p)), path(std::move(target)) {}
+
+    bool deliver(const string& chunk, string& error) override {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (!socketsReady() || getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0 || !found) {
+            error = "cannot resolve " + host;
+            return false;
+        }
+        SocketHandle s = NO_SOCKET;
+        for (addrinfo* a = found; a && s == NO_SOCKET; a = a->ai_next) {
+            s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (s == NO_SOCKET) continue;
+            setSocketTimeout(s, 10);
+            if (connect(s, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0) {
+                closeSocket(s);
+                s = NO_SOCKET;
+            }
+        }
+        freeaddrinfo(found);
+        if (s == NO_SOCKET) {
+            error = "cannot connect to " + host + ":" + port;
+            return false;
+        }
+        string request = "POST " + path + " HTTP/1.1\r\nHost: " + host + "\r\nContent-Type: application/octet-stream"
+            "\r\nConnection: close\r\nContent-Length: " + to_string(chunk.size()) + "\r\n\r\n";
+        string head, body;
+        bool ok = sendAll(s, request.data(), request.size()) && sendAll(s, chunk.data(), chunk.size())
+            && readHttpMessage(s, head, body);
+        closeSocket(s);
+        if (!ok) {
+            error = "no response from " + host + ":" + port;
+            return false;
+        }
+        if (head.compare(0, 12, "HTTP/1.1 200") != 0 && head.compare(0, 12, "HTTP/1.0 200") != 0) {
+            error = head.substr(0, head.find("\r\n"));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    string host, port, path;
+};
+
+// --receive-sales <port> <dir>: a stand-in for HQ's endpoint, storing
+// each POSTed chunk as the file sink would. Runs until killed.
+int receiveSales(const string& port, const string& dir) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* bound = nullptr;
+    if (!socketsReady() || getaddrinfo(nullptr, port.c_str(), &hints, &bound) != 0 || !bound) {
+        cerr << "Bad port: " << port << "\n";
+        return 1;
+    }
+    SocketHandle listener = socket(bound->ai_family, bound->ai_socktype, bound->ai_protocol);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    const bool listening = listener != NO_SOCKET && ::bind(listener, bound->ai_addr, static_cast<int>(bound->ai_addrlen)) == 0
+        && listen(listener, 16) == 0;
+    freeaddrinfo(bound);
+    if (!listening) {
+        cerr << "Cannot listen on port " << port << "\n";
+        return 1;
+    }
+    cout << "Receiving sales on port " << port << " into " << dir << "\n" << flush;
+    while (true) {
+        SocketHandle s = accept(listener, nullptr, nullptr);
+        if (s == NO_SOCKET) continue;
+        setSocketTimeout(s, 10);
+        string head, body, error;
+        ShipmentHeader h;
+        bool duplicate = false;
+        const char* status = "400 Bad Request";
+        if (readHttpMessage(s, head, body) && head.compare(0, 5, "POST ") == 0) {
+            if (storeShipment(dir, body, h, duplicate, error)) {
+                status = "200 OK";
+                cout << h.branch << " #" << h.seq << ": " << h.records << (h.records == 1 ? " order" : " orders") << (duplicate ? " (again)" : "") << "\n" << flush;
+            }
+            else {
+                status = error == "damaged chunk" ? "400 Bad Request" : "500 Internal Server Error";
+                cerr << error << "\n";
+            }
+        }
+        const string response = string("HTTP/1.1 ") + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        sendAll(s, response.data(), response.size());
+        closeSocket(s);
+    }
+}
+
+/* ---- Shipper ---- */
+class SalesShipper {
+public:
+    static const size_t CHUNK_RECORDS = 50000; // and never more than one segment
+
+    ~SalesShipper() { stop(); }
+
+    // Resumes after the last chunk the sink accepted: chunks still in the
+    // spool go first, then journal records after the last spooled one.
+    bool start(const string& journal, const string& spoolDir, const string& branchName, unique_ptr<ChunkSink> to,
+        chrono::milliseconds every, string& error) {
+        journalPath = journal;
+        spool = spoolDir;
+        branch = branchName;
+        sink = std::move(to);
+        interval = every;
+        if (!makeDirectory(spool)) {
+            error = "cannot create " + spool;
+            return false;
+        }
+        string text;
+        if (readFileRange(spool + "/checkpoint", 0, 256, text) && !text.empty()) {
+            unsigned long long seq = 0, record = 0, byte = 0;
+            unsigned segment = 1;
+            istringstream in(text);
+            if (!(in >> seq >> segment >> record >> byte)) {
+                error = spool + "/checkpoint: damaged";
+                return false;
+            }
+            shipped = seq;
+            tail = JournalPosition{ segment, record, byte };
+        }
+        nextSeq = shipped + 1;
+        string chunk;
+        while (readFileRange(chunkPath(nextSeq), 0, static_cast<size_t>(fileSize(chunkPath(nextSeq))), chunk)) {
+            ShipmentHeader h;
+            const char* p;
+            const char* e;
+            if (!readShipment(chunk, h, p, e) || h.seq != nextSeq) {
+                error = chunkPath(nextSeq) + ": damaged";
+                return false;
+            }
+            tail = h.to;
+            ++nextSeq;
+        }
+        worker = thread([this]() { run(); });
+        return true;
+    }
+
+    // Spools what the journal holds and makes one last delivery attempt;
+    // anything left goes out on the next start.
+    void stop() {
+        if (!worker.joinable()) return;
+        {
+            lock_guard<mutex> lock(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+    unsigned long long shippedCount() const { return shipped.load(); }
+    unsigned long long waitingCount() const { return nextSeq.load() - 1 - shipped.load(); }
+    string lastError() const {
+        lock_guard<mutex> lock(m);
+        return failure;
+    }
+
+private:
+    string journalPath, spool, branch;
+    unique_ptr<ChunkSink> sink;
+    chrono::milliseconds interval{ 1000 };
+    JournalPosition tail;                       // end of the last spooled chunk
+    atomic<unsigned long long> shipped{ 0 };    // last chunk the sink accepted
+    atomic<unsigned long long> nextSeq{ 1 };
+    thread worker;
+    mutable mutex m;
+    condition_variable wake;
+    bool stopping = false;
+    string failure;
+
+    string chunkPath(unsigned long long seq) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/chunk.%010llu", seq);
+        return spool + name;
+    }
+
+    void run() {
+        auto backoff = interval;
+        auto retryAt = chrono::steady_clock::now();
+        while (true) {
+            bool last;
+            {
+                unique_lock<mutex> lock(m);
+                wake.wait_for(lock, interval, [this]() { return stopping; });
+                last = stopping;
+            }
+            while (spoolNext()) {}
+            if (last || chrono::steady_clock::now() >= retryAt) {
+                if (deliverSpooled()) backoff = interval;
+                else {
+                    backoff = min<chrono::milliseconds>(backoff * 2, chrono::milliseconds(30000));
+                    retryAt = chrono::steady_clock::now() + backoff;
+                }
+            }
+            if (last) return;
+        }
+    }
+
+    // Takes up to CHUNK_RECORDS new journal records, from one segment, into
+    // the next spooled chunk. False when there were none.
+    bool spoolNext() {
+        MemScope scope(MemTag::Journal);
+        JournalPosition at = tail;
+        string text, file;
+        uint32_t records = 0;
+        vector<string_view> f;
+        auto take = [&](const vector<string_view>& fields) {
+            for (size_t k = 0; k < fields.size(); ++k) {
+                if (k) text += '\t';
+                text.append(fields[k].data(), fields[k].size());
+            }
+            text += '\n';
+            ++records;
+        };
+        while (true) {
+            const string path = segmentPath(journalPath, at.segment);
+            const bool sealed = fileExists(segmentPath(journalPath, at.segment + 1)); // the writer has moved on
+            if (!readFileRange(path, 0, 4, file)) break;
+            if (file == "JCSB") {
+                readFileRange(path, 0, static_cast<size_t>(fileSize(path)), file);
+                const char* footer;
+                const char* footerEnd;
+                size_t payload = file.size();
+                findFooter(file, footer, footerEnd, payload);
+                uint64_t index = 0;
+                size_t malformed = 0;
+                forEachStoredRecord(file.data(), file.data() + payload, [&](const vector<string_view>& fields) {
+                    if (index++ >= at.record && records < CHUNK_RECORDS) {
+                        take(fields);
+                        ++at.record;
+                    }
+                    }, &malformed);
+            }
+            else {
+                // Text, still being appended or sealed with compression off.
+                // Sealing may swap in the compressed file between our reads;
+                // if it did, read the segment again as blocks.
+                const unsigned long long size = fileSize(path);
+                readFileRange(path, at.byte, static_cast<size_t>(size - min<unsigned long long>(size, at.byte)), file);
+                string magic;
+                if (!readFileRange(path, 0, 4, magic) || magic == "JCSB") continue;
+                const char* p = file.data();
+                const char* end = p + file.size();
+                while (p < end && records < CHUNK_RECORDS) {
+                    const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+                    if (!nl) break;
+                    string_view line(p, static_cast<size_t>(nl - p));
+                    if (line.size() >= 4 && memcmp(line.data(), "JCSF", 4) == 0) break;
+                    p = nl + 1;
+                    at.byte += line.size() + 1;
+                    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+                    if (line.empty() || line[0] == '#') continue;
+                    splitTabViews(line, f);
+                    if (!wellFormedRecord(f)) continue; // readers skip these too
+                    take(f);
+                    ++at.record;
+                }
+            }
+            if (records || !sealed) break;
+            at = JournalPosition{ at.segment + 1, 0, 0 };
+        }
+        if (!records) {
+            tail = at; // skipped past finished segments
+            return false;
+        }
+
+        ShipmentHeader h;
+        h.seq = nextSeq;
+        h.branch = branch;
+        h.from = tail;
+        h.to = at;
+        h.records = records;
+        string payload, chunk;
+        encodeJournalBlocks(text.data(), text.data() + text.size(), JournalCompression::DictionaryLz, payload);
+        appendShipment(chunk, h, payload);
+        if (!writeFileAtomic(chunkPath(h.seq), chunk)) {
+            setFailure("cannot write " + chunkPath(h.seq));
+            return false;
+        }
+        tail = at;
+        ++nextSeq;
+        return true;
+    }
+
+    bool deliverSpooled() {
+        string chunk, error;
+        while (shipped + 1 < nextSeq) {
+            const unsigned long long seq = shipped + 1;
+            ShipmentHeader h;
+            const char* p;
+            const char* e;
+            if (!readFileRange(chunkPath(seq), 0, static_cast<size_t>(fileSize(chunkPath(seq))), chunk)
+                || !readShipment(chunk, h, p, e)) {
+                setFailure(chunkPath(seq) + ": damaged");
+                return false;
+            }
+            if (!sink->deliver(chunk, error)) {
+                setFailure(error);
+                return false;
+            }
+            char line[96];
+            snprintf(line, sizeof(line), "%llu %u %llu %llu\n", seq, h.to.segment,
+                static_cast<unsigned long long>(h.to.record), static_cast<unsigned long long>(h.to.byte));
+            if (!writeFileAtomic(spool + "/checkpoint", line)) {
+                setFailure("cannot write " + spool + "/checkpoint");
+                return false;
+            }
+            remove(chunkPath(seq).c_str());
+            shipped = seq;
+        }
+        setFailure(string());
+        return true;
+    }
+
+    void setFailure(const string& e) {
+        lock_guard<mutex> lock(m);
+        failure = e;
+    }
+};
+
+/* -------------------- Demand Planning -------------------- */
+// --plan <journal>: tomorrow's demand per item from archived sales, with
+// suggested opening stock and reorder quantities.
+// Sales are bucketed by hour, and each item gets additive Holt-Winters
+// smoothing over an hour-of-week season (168 slots), which covers the
+// daily rushes and the weekday/weekend swing together:
+//   e = y - (L + S[h]);  L += alpha e;  S[h] += gamma (y - L - S[h])
+// History is kept hour-major (a row of items per hour) and the smoothing
+// state item-major, so each hour is one branch-free pass over a batch of
+// items that the compiler vectorizes; batches run on the work-stealing
+// pool. Hours are UTC, as journaled.
+const size_t WEEK_HOURS = 168;
+const size_t PLAN_BATCH = 256;
+const int MAX_HISTORY_DAYS = 3660; // ten years; the window is allocated in full
+
+struct PlanOptions {
+    int historyDays = 28;
+    float alpha = 0.01f;   // level
+    float gamma = 0.3f;    // season
+    float beta = 0.05f;    // residual variance
+    double serviceZ = 1.65; // safety stock covers ~95% of days
+};
+
+struct DemandHistory {
+    unsigned long long firstHour = 0; // hours since the epoch
+    size_t hours = 0, items = 0;
+    vector<float> demand;             // demand[h * items + i]
+    long long orders = 0;
+    vector<long long> sold;           // units per item over the whole journal, window or not
+};
+
+size_t hourOfWeek(unsigned long long hour) {
+    return static_cast<size_t>(((hour / 24 + 3) % 7) * 24 + hour % 24); // Monday 00:00 is slot 0
+}
+
+// Buckets every journaled sale by hour, ending at the midnight after the
+// last one and going back at most `historyDays`. Each worker drops hours
+// that fall out of the window behind the latest it has seen, so memory
+// follows the window, not the archive. The same pass totals each item's
+// units over the whole journal, for stock on hand. Returns false with
+// `error` set if the journal is missing or damaged.
+bool loadDemandHistory(const string& path, Menu& menu, const PlanOptions& opt, WorkStealingPool& pool,
+    DemandHistory& h, string& error) {
+    const vector<JournalSpan> spans = journalSpans(path);
+    if (spans.empty()) {
+        error = "no journal at " + path;
+        return false;
+    }
+    menu.ensureIndexes(); // find() is read-only from here on
+    const size_t n = menu.size();
+    struct HourRow {
+        vector<float> demand;
+        long long orders = 0;
+    };
+    struct WorkerRows {
+        map<unsigned long long, HourRow> rows;
+        vector<long long> sold;
+        unsigned long long cutoff = 0; // hours before this are outside every window
+        size_t malformed = 0;
+    };
+    const unsigned long long windowHours = static_cast<unsigned long long>(max(opt.historyDays, 1)) * 24;
+    vector<WorkerRows> workers(pool.size());
+    for (auto& w : workers) w.sold.assign(n, 0);
+    vector<string> errors(spans.size());
+
+    auto parse = [&](const char* p, const char* end, WorkerRows& w) {
+        unsigned long long lastHour = ~0ULL;
+        HourRow* row = nullptr;
+        return forEachStoredRecord(p, end, [&](const vector<string_view>& f) {
+            unsigned long long ms = 0;
+            for (char c : f[1]) ms = ms * 10 + static_cast<unsigned>(c - '0');
+            const unsigned long long hour = ms / 3600000ULL;
+            if (hour != lastHour) {
+                lastHour = hour;
+                const unsigned long long dayEnd = (hour / 24 + 1) * 24;
+                const unsigned long long cutoff = dayEnd - min(dayEnd, windowHours);
+                if (cutoff > w.cutoff) {
+                    w.cutoff = cutoff;
+                    w.rows.erase(w.rows.begin(), w.rows.lower_bound(cutoff));
+                }
+                row = nullptr;
+                if (hour >= w.cutoff) {
+                    row = &w.rows[hour];
+                    if (row->demand.empty()) row->demand.assign(n, 0.0f);
+                }
+            }
+            for (size_t k = 4; k + 1 < f.size(); k += 2) {
+                const long idx = menu.find(f[k + 1]);
+                if (idx < 0) continue; // item since removed from the menu
+                const int qty = parseQuantity(f[k]);
+                w.sold[static_cast<size_t>(idx)] += qty;
+                if (row) row->demand[static_cast<size_t>(idx)] += static_cast<float>(qty);
+            }
+            if (row) ++row->orders;
+            }, &w.malformed);
+    };
+    pool.parallelFor(0, spans.size(), 1, [&](size_t b, size_t e) {
+        WorkerRows& w = workers[static_cast<size_t>(max(WorkStealingPool::currentWorker(), 0))];
+        string data;
+        for (size_t i = b; i < e; ++i) {
+            const JournalSpan& s = spans[i];
+            size_t start = 0, payload = 0;
+            if (s.whole) {
+                readFileRange(s.path, 0, static_cast<size_t>(fileSize(s.path)), data);
+                const char* footer;
+                const char* footerEnd;
+                payload = data.size();
+                findFooter(data, footer, footerEnd, payload);
+            }
+            else {
+                readJournalRange(s, data, start);
+                payload = data.size();
+            }
+            if (!parse(data.data() + start, data.data() + payload, w)) errors[i] = s.path + ": malformed record";
+        }
+        });
+    for (const auto& e : errors) {
+        if (!e.empty()) {
+            error = e;
+            return false;
+        }
+    }
+
+    unsigned long long lastHour = 0, earliest = ~0ULL;
+    size_t malformed = 0;
+    h.sold.assign(n, 0);
+    for (const auto& w : workers) {
+        for (size_t i = 0; i < n; ++i) h.sold[i] += w.sold[i];
+        malformed += w.malformed;
+        if (w.rows.empty()) continue;
+        earliest = min(earliest, w.rows.begin()->first);
+        lastHour = max(lastHour, w.rows.rbegin()->first);
+    }
+    if (malformed) {
+        cerr << "Journal " << path << ": skipped " << malformed
+            << (malformed == 1 ? " malformed record\n" : " malformed records\n");
+    }
+    if (earliest == ~0ULL) {
+        error = "no orders in " + path;
+        return false;
+    }
+    const unsigned long long endHour = (lastHour / 24 + 1) * 24;
+    h.firstHour = max(earliest - earliest % 24, endHour - min(endHour, windowHours));
+    h.hours = static_cast<size_t>(endHour - h.firstHour);
+    h.items = n;
+    h.demand.assign(h.hours * n, 0.0f);
+    h.orders = 0;
+    for (const auto& w : workers) {
+        for (const auto& r : w.rows) {
+            if (r.first < h.firstHour) continue;
+            float* dst = &h.demand[static_cast<size_t>(r.first - h.firstHour) * n];
+            for (size_t i = 0; i < n; ++i) dst[i] += r.second.demand[i];
+            h.orders += r.second.orders;
+        }
+    }
+    return true;
+}
+
+// Fits every item on hours [0, fitHours) and forecasts the 24 after:
+// expected units and the variance of that day's total.
+void forecastDay(const DemandHistory& h, size_t fitHours, const PlanOptions& opt, WorkStealingPool& pool,
+    vector<float>& forecast, vector<float>& variance) {
+    const size_t n = h.items;
+    forecast.assign(n, 0.0f);
+    variance.assign(n, 0.0f);
+    pool.parallelFor(0, (n + PLAN_BATCH - 1) / PLAN_BATCH, 1, [&](size_t b, size_t e) {
+        vector<float> level(PLAN_BATCH), resid(PLAN_BATCH), open(PLAN_BATCH), season(WEEK_HOURS * PLAN_BATCH);
+        for (size_t batch = b; batch < e; ++batch) {
+            const size_t i0 = batch * PLAN_BATCH;
+            const size_t m = min(PLAN_BATCH, n - i0);
+            float* L = level.data();
+            float* V = resid.data();
+            fill(level.begin(), level.end(), 0.0f);
+            fill(resid.begin(), resid.end(), 0.0f);
+            fill(open.begin(), open.end(), 0.0f);
+            fill(season.begin(), season.end(), 0.0f);
+
+            // Start from the first week as is when there are two or more.
+            size_t t = 0;
+            if (fitHours >= 2 * WEEK_HOURS) {
+                for (; t < WEEK_HOURS; ++t) {
+                    const float* y = &h.demand[t * n + i0];
+                    for (size_t i = 0; i < m; ++i) L[i] += y[i];
+                }
+                for (size_t i = 0; i < m; ++i) L[i] /= static_cast<float>(WEEK_HOURS);
+                for (size_t k = 0; k < WEEK_HOURS; ++k) {
+                    const float* y = &h.demand[k * n + i0];
+                    float* S = &season[hourOfWeek(h.firstHour + k) * PLAN_BATCH];
+                    for (size_t i = 0; i < m; ++i) S[i] = y[i] - L[i];
+                }
+            }
+            const float a = opt.alpha, g = opt.gamma, r = opt.beta;
+            for (; t < fitHours; ++t) {
+                const float* y = &h.demand[t * n + i0];
+                float* S = &season[hourOfWeek(h.firstHour + t) * PLAN_BATCH];
+                for (size_t i = 0; i < m; ++i) {
+                    const float err = y[i] - L[i] - S[i];
+                    L[i] += a * err;
+                    S[i] += g * (y[i] - L[i] - S[i]);
+                    V[i] += r * (err * err - V[i]);
+                }
+            }
+
+            float* F = &forecast[i0];
+            for (size_t k = 0; k < 24; ++k) {
+                const float* S = &season[hourOfWeek(h.firstHour + fitHours + k) * PLAN_BATCH];
+                for (size_t i = 0; i < m; ++i) {
+                    const float f = max(L[i] + S[i], 0.0f);
+                    F[i] += f;
+                    open[i] += f > 0.05f ? 1.0f : 0.0f; // closed hours add no uncertainty
+                }
+            }
+            for (size_t i = 0; i < m; ++i) variance[i0 + i] = V[i] * open[i];
+        }
+        });
+}
+
+// Weighted absolute error of a day's forecast against what sold.
+double weightedError(const vector<float>& forecast, const float* actual, size_t stride, size_t hours) {
+    double err = 0.0, total = 0.0;
+    for (size_t i = 0; i < forecast.size(); ++i) {
+        double sold = 0.0;
+        for (size_t k = 0; k < hours; ++k) sold += actual[k * stride + i];
+        err += fabs(forecast[i] - sold);
+        total += sold;
+    }
+    return total > 0.0 ? err / total : 0.0;
+}
+
+int runPlan(const string& journal, Menu& menu, const PlanOptions& opt, const char* outPath) {
+    auto t0 = chrono::steady_clock::now();
+    WorkStealingPool pool; // one set of workers for reading and both fits
+    DemandHistory h;
+    string error;
+    if (!loadDemandHistory(journal, menu, opt, pool, h, error)) {
+        cerr << "Cannot plan: " << error << "\n";
+        return 1;
+    }
+    // On hand is the menu's stock less what the journal has sold since.
+    for (size_t i = 0; i < menu.size(); ++i) {
+        menu.items[i].qty -= static_cast<int>(h.sold[i]);
+        menu.items[i].sold += static_cast<int>(h.sold[i]);
+    }
+    auto t1 = chrono::steady_clock::now();
+    vector<float> forecast, variance;
+    forecastDay(h, h.hours, opt, pool, forecast, variance);
+    auto t2 = chrono::steady_clock::now();
+
+    // Stock below zero means restocks the journal never saw; count it as none.
+    struct Line { size_t item; int opening, onHand, reorder; };
+    vector<Line> plan(menu.size());
+    for (size_t i = 0; i < menu.size(); ++i) {
+        const int opening = static_cast<int>(ceil(forecast[i] + opt.serviceZ * sqrt(variance[i]) - 1e-3));
+        const int onHand = max(0, menu.items[i].qty);
+        plan[i] = Line{ i, opening, onHand, max(0, opening - onHand) };
+    }
+
+    const time_t day = static_cast<time_t>((h.firstHour + h.hours) * 3600ULL);
+    tm utc{};
+#ifdef _WIN32
+    gmtime_s(&utc, &day);
+#else
+    gmtime_r(&day, &utc);
+#endif
+    char date[32];
+    strftime(date, sizeof(date), "%a %Y-%m-%d", &utc);
+    screen() << Colors::TITLE << "\n=== Demand Plan for " << date << " ===\n" << Colors::RESET;
+    screen() << h.orders << " orders over " << h.hours / 24 << " days, " << menu.size() << " items\n";
+    if (h.hours >= 24 + WEEK_HOURS) {
+        vector<float> backF, backV;
+        forecastDay(h, h.hours - 24, opt, pool, backF, backV);
+        const float* lastDay = &h.demand[(h.hours - 24) * h.items];
+        const float* weekBefore = &h.demand[(h.hours - 24 - WEEK_HOURS) * h.items];
+        vector<float> naive(h.items, 0.0f);
+        for (size_t k = 0; k < 24; ++k) {
+            for (size_t i = 0; i < h.items; ++i) naive[i] += weekBefore[k * h.items + i];
+        }
+        screen() << "Backtest on the last day: " << fixed << setprecision(1)
+            << weightedError(backF, lastDay, h.items, 24) * 100.0 << "% weighted error (same day last week: "
+            << weightedError(naive, lastDay, h.items, 24) * 100.0 << "%)\n";
+    }
+
+    vector<Line> top = plan;
+    const size_t shown = min<size_t>(15, top.size());
+    partial_sort(top.begin(), top.begin() + static_cast<long>(shown), top.end(), [](const Line& a, const Line& b) {
+        return a.reorder != b.reorder ? a.reorder > b.reorder : a.opening > b.opening;
+        });
+    screen() << "\n" << left << setw(32) << "item" << right << setw(10) << "forecast" << setw(9) << "opening"
+        << setw(9) << "on hand" << setw(9) << "reorder" << "\n";
+    for (size_t k = 0; k < shown; ++k) {
+        const Line& l = top[k];
+        const Item& it = menu.items[l.item];
+        screen() << left << setw(32) << it.name << right << setw(10) << fixed << setprecision(1) << forecast[l.item]
+            << setw(9) << l.opening << setw(9) << l.onHand << setw(9) << l.reorder << "\n";
+    }
+    long long units = 0;
+    for (const auto& l : plan) units += l.reorder;
+    screen() << Colors::MUTED << "(" << units << " units to reorder across the menu; read "
+        << fixed << setprecision(0) << chrono::duration<double, milli>(t1 - t0).count() << " ms, fit "
+        << chrono::duration<double, milli>(t2 - t1).count() << " ms)\n" << Colors::RESET;
+
+    // --plan-out <file>: every item, tab-separated
+    if (outPath) {
+        string text = "# item\tforecast\topening\ton hand\treorder\n";
+        char num[32];
+        for (const auto& l : plan) {
+            const Item& it = menu.items[l.item];
+            snprintf(num, sizeof(num), "%.1f", forecast[l.item]);
+            text += it.name; text += '\t';
+            text += num; text += '\t';
+            text += to_string(l.opening); text += '\t';
+            text += to_string(l.onHand); text += '\t';
+            text += to_string(l.reorder); text += '\n';
+        }
+        if (!writeFileAtomic(outPath, text)) {
+            cerr << "Cannot write plan: " << outPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* -------------------- Synthetic Data Generator -------------------- */
+// --generate <prefix> writes <prefix>menu.txt and <prefix>journal.txt, or
+// with compression the journal as sealed segments <prefix>journal.txt.NNNNNN.
+// Orders are produced in fixed-size chunks, each with its own RNG stream
+// derived from (seed, chunk), so output is identical for any thread count.
+struct GeneratorOptions {
+    size_t items = 1000;
+    size_t orders = 100000;
+    int days = 30;
+    unsigned long long seed = 1;
+    long long startDay = 19723; // first day, in days since 1970-01-01: Monday 2024-01-01
+    unsigned threads = 0;
+    JournalCompression compression = JournalCompression::Off;
+};
+
+// Days since 1970-01-01 of a Gregorian YYYY-MM-DD, false if malformed.
+bool parseDate(const char* s, long long& days) {
+    char* end;
+    long y = strtol(s, &end, 10);
+    if (*end != '-') return false;
+    long m = strtol(end + 1, &end, 10);
+    if (*end != '-') return false;
+    long d = strtol(end + 1, &end, 10);
+    if (*end || y < 1970 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+    y -= m <= 2;
+    const long era = y / 400;
+    const long yoe = y - era * 400;
+    const long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    days = era * 146097LL + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+    return true;
+}
+
+struct GeneratorModel {
+    vector<string> names;          // menu item names
+    vector<double> itemCdf;        // Zipf popularity, cumulative
+    vector<uint32_t> rankToItem;   // popularity rank -> item
+    vector<string> customers;
+    vector<double> customerCdf;    // regulars come back more often
+    vector<double> timeCdf;        // cumulative intensity per hour over all days
+    unsigned long long startMs = 0;
+};
+
+vector<double> zipfCdf(size_t n, double s) {
+    vector<double> cdf(n);
+    double sum = 0.0;
+    for (size_t r = 0; r < n; ++r) {
+        sum += 1.0 / pow(static_cast<double>(r + 1), s);
+        cdf[r] = sum;
+    }
+    for (auto& c : cdf) c /= sum;
+    return cdf;
+}
+
+size_t sampleCdf(const vector<double>& cdf, double u) {
+    size_t k = static_cast<size_t>(lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    return k < cdf.size() ? k : cdf.size() - 1;
+}
+
+void generateMenu(const GeneratorOptions& opt, GeneratorModel& model, string& out) {
+    static const char* const CATS[] = { "Beverages", "Snacks", "Meals", "Desserts" };
+    static const double BASE_PRICE[] = { 140.0, 90.0, 220.0, 120.0 };
+    static const char* const STYLE[] = { "Classic", "Iced", "Hot", "House", "Spiced", "Honey", "Toasted",
+        "Double", "Mini", "Garden", "Smoky", "Creamy" };
+    static const char* const NOUN[4][6] = {
+        { "Latte", "Cappuccino", "Americano", "Mocha", "Matcha", "Milkshake" },
+        { "Muffin", "Toast", "Donut Holes", "Croissant", "Scone", "Nachos" },
+        { "Wrap", "Burger", "Pasta", "Rice Bowl", "Sandwich", "Salad" },
+        { "Cake Slice", "Parfait", "Tiramisu", "Brownie", "Cheesecake", "Pie" } };
+    static const AttrMask CAT_ATTRS[] = { ATTR_DAIRY | ATTR_CAFFEINE, ATTR_GLUTEN | ATTR_EGG,
+        ATTR_GLUTEN, ATTR_DAIRY | ATTR_EGG | ATTR_GLUTEN };
+
+    mt19937_64 rng(opt.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    lognormal_distribution<double> spread(0.0, 0.25);
+
+    model.itemCdf = zipfCdf(opt.items, 1.1);
+    model.rankToItem.resize(opt.items);
+    for (size_t i = 0; i < opt.items; ++i) model.rankToItem[i] = static_cast<uint32_t>(i);
+    shuffle(model.rankToItem.begin(), model.rankToItem.end(), rng);
+
+    // stock covers expected demand over the whole history plus a margin,
+    // so replaying the journal never drives an item negative
+    vector<double> share(opt.items);
+    for (size_t r = 0; r < opt.items; ++r) {
+        share[model.rankToItem[r]] = model.itemCdf[r] - (r ? model.itemCdf[r - 1] : 0.0);
+    }
+    const double unitsPerOrder = 2.3;
+
+    out = "# James' Cafe menu v1 (generated, seed " + to_string(opt.seed) + ")\n";
+    model.names.resize(opt.items);
+    for (size_t i = 0; i < opt.items; ++i) {
+        int c = static_cast<int>(i % 4);
+        model.names[i] = string(STYLE[rng() % 12]) + " " + NOUN[c][rng() % 6] + " #" + to_string(i + 1);
+        Item it(model.names[i], floor(BASE_PRICE[c] * spread(rng)), 0, CATS[c]);
+        it.qty = static_cast<int>(ceil(share[i] * opt.orders * unitsPerOrder * 1.25)) + 20;
+        AttrMask a = CAT_ATTRS[c];
+        if (unit(rng) < 0.15) a = ATTR_VEGAN | ATTR_VEGETARIAN | (a & ~(ATTR_DAIRY | ATTR_EGG));
+        else if (unit(rng) < 0.4) a |= ATTR_VEGETARIAN;
+        if (unit(rng) < 0.1) a |= ATTR_NUTS;
+        if (unit(rng) < 0.2) a &= ~ATTR_GLUTEN;
+        appendMenuRecord(out, it, a);
+    }
+}
+
+void buildOrderModel(const GeneratorOptions& opt, GeneratorModel& model) {
+    static const char* const FIRST[] = { "Ana", "Ben", "Carla", "Dan", "Ella", "Finn", "Gia", "Hugo", "Iris",
+        "Jon", "Kai", "Lara", "Migs", "Nina", "Oli", "Pia", "Quin", "Rey", "Sofia", "Tom" };
+    // opening hours 7:00-21:00 with breakfast, lunch and merienda peaks
+    static const double HOURLY[24] = { 0, 0, 0, 0, 0, 0, 0, 6, 10, 7, 4, 6, 10, 9, 5, 7, 8, 5, 4, 3, 2, 0, 0, 0 };
+
+    size_t customerCount = max<size_t>(50, opt.orders / 20);
+    model.customers.resize(customerCount);
+    for (size_t i = 0; i < customerCount; ++i) {
+        model.customers[i] = string(FIRST[i % 20]) + " " + static_cast<char>('A' + (i / 20) % 26)
+            + (i >= 520 ? to_string(i / 520) : string());
+    }
+    model.customerCdf = zipfCdf(customerCount, 0.8);
+
+    model.timeCdf.assign(static_cast<size_t>(opt.days) * 24, 0.0);
+    double sum = 0.0;
+    for (size_t h = 0; h < model.timeCdf.size(); ++h) {
+        sum += HOURLY[h % 24] * ((h / 24) % 7 >= 5 ? 1.3 : 1.0); // busier weekends
+        model.timeCdf[h] = sum;
+    }
+    for (auto& c : model.timeCdf) c /= sum;
+
+    // a fixed start keeps the output a function of the options alone; day 0
+    // is a Monday, as the weekend boost above assumes
+    model.startMs = static_cast<unsigned long long>(opt.startDay) * 86400000ULL;
+}
+
+// Orders [first, last): timestamps follow the intensity curve in sequence
+// order, so concatenated chunks form one chronological journal.
+void generateOrders(const GeneratorOptions& opt, const GeneratorModel& model, size_t chunk,
+    size_t first, size_t last, string& out) {
+    static const int BASKET_WEIGHTS[] = { 45, 28, 14, 7, 4, 2 };
+    mt19937_64 rng(opt.seed * 0x9E3779B97F4A7C15ULL + chunk + 1);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    discrete_distribution<int> basket(begin(BASKET_WEIGHTS), end(BASKET_WEIGHTS));
+    static const string EAT_IN = "Eat-In", TAKE_OUT = "Take-Out";
+
+    out.clear();
+    for (size_t k = first; k < last; ++k) {
+        double q = (static_cast<double>(k) + unit(rng)) / static_cast<double>(opt.orders);
+        size_t hour = sampleCdf(model.timeCdf, q);
+        double lo = hour ? model.timeCdf[hour - 1] : 0.0;
+        double frac = (q - lo) / max(1e-12, model.timeCdf[hour] - lo);
+        unsigned long long ms = model.startMs + hour * 3600000ULL + static_cast<unsigned long long>(frac * 3600000.0);
+
+        const string& customer = model.customers[sampleCdf(model.customerCdf, unit(rng))];
+        journalBegin(out, k + 1, ms, customer, unit(rng) < 0.4 ? EAT_IN : TAKE_OUT);
+        int lines = 1 + basket(rng);
+        for (int l = 0; l < lines; ++l) {
+            uint32_t item = model.rankToItem[sampleCdf(model.itemCdf, unit(rng))];
+            int qty = unit(rng) < 0.8 ? 1 : 2 + static_cast<int>(rng() % 2);
+            journalLine(out, qty, model.names[item]);
+        }
+        out += '\n';
+    }
+}
+
+int runGenerator(const string& prefix, const GeneratorOptions& opt) {
+    auto t0 = chrono::steady_clock::now();
+    GeneratorModel model;
+    string menuText;
+    generateMenu(opt, model, menuText);
+    buildOrderModel(opt, model);
+
+    const string journalPath = prefix + "journal.txt";
+    const bool segmented = opt.compression != JournalCompression::Off;
+    ofstream menuFile(prefix + "menu.txt", ios::binary | ios::trunc);
+    JournalWriter journalFile;
+    if (!menuFile || (!segmented && !journalFile.open(journalPath, true))) {
+        cerr << "Cannot write to " << prefix << "menu.txt / journal.txt\n";
+        return 1;
+    }
+    menuFile << menuText;
+    menuFile.close();
+
+    // Segmented: cut a segment at the first chunk boundary past the size,
+    // with footer totals priced from the menu just written.
+    Menu menu;
+    string error;
+    string segmentText;
+    unsigned segments = 0;
+    unsigned long long stored = 0;
+    auto sealSegment = [&]() {
+        SegmentTotals totals;
+        forEachJournalRecord(segmentText.data(), segmentText.data() + segmentText.size(),
+            [&](const vector<string_view>& f) { totals.addRecord(f, menu); });
+        const string path = segmentPath(journalPath, ++segments);
+        bool ok = writeSealedSegment(path, segmentText.data(), segmentText.size(), totals, opt.compression);
+        stored += fileSize(path);
+        segmentText.clear();
+        return ok;
+    };
+    if (segmented) {
+        if (!loadMenuFile(prefix + "menu.txt", menu, error)) {
+            cerr << "Cannot reload " << prefix << "menu.txt: " << error << "\n";
+            return 1;
+        }
+        menu.buildIndexes();
+        // replace the previous output, whichever form it took
+        remove(journalPath.c_str());
+        for (unsigned n = 1; fileExists(segmentPath(journalPath, n)); ++n) remove(segmentPath(journalPath, n).c_str());
+    }
+
+    // Generate a round of chunks in parallel, then write them in order.
+    const size_t CHUNK = 20000;
+    WorkStealingPool pool(opt.threads);
+    const size_t perRound = pool.size() * 4;
+    const size_t chunks = (opt.orders + CHUNK - 1) / CHUNK;
+    vector<string> buffers(perRound);
+    unsigned long long bytes = menuText.size();
+    bool journalOk = true;
+    unsigned long long last = 0;
+    for (size_t base = 0; base < chunks; base += perRound) {
+        size_t n = min(perRound, chunks - base);
+        pool.parallelFor(0, n, 1, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) {
+                size_t c = base + i;
+                generateOrders(opt, model, c, c * CHUNK, min(opt.orders, (c + 1) * CHUNK), buffers[i]);
+            }
+            });
+        for (size_t i = 0; i < n; ++i) {
+            bytes += buffers[i].size();
+            if (!segmented) {
+                last = journalFile.append(buffers[i].data(), buffers[i].size()); // copied: the buffer is free to reuse
+                continue;
+            }
+            segmentText += buffers[i];
+            if (segmentText.size() >= SEGMENT_BYTES && !sealSegment()) journalOk = false;
+        }
+    }
+    if (segmented && !segmentText.empty() && !sealSegment()) journalOk = false;
+    if (!segmented) journalFile.waitDurable(last);
+    journalFile.close();
+    if (!journalFile.ok() || !journalOk) {
+        cerr << "Write failed for " << prefix << "journal.txt\n";
+        return 1;
+    }
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Generated " << opt.items << " items and " << opt.orders << " orders over " << opt.days
+        << " days (seed " << opt.seed << ", " << pool.size() << " threads)\n"
+        << fixed << setprecision(2) << "  " << bytes / 1048576.0 << " MiB in " << secs << " s ("
+        << bytes / 1048576.0 / max(secs, 1e-9) << " MiB/s, " << (segmented ? "sealed segments" : journalFile.backend()) << ")\n";
+    if (segmented) {
+        const double records = static_cast<double>(bytes - menuText.size());
+        cout << "  journal: " << segments << " segments, " << stored / 1048576.0 << " MiB stored ("
+            << setprecision(1) << records / max<double>(static_cast<double>(stored), 1.0) << "x, "
+            << static_cast<double>(stored) / max<double>(static_cast<double>(opt.orders), 1.0) << " bytes/order, "
+            << compressionName(opt.compression) << ")\n";
+    }
+    return 0;
+}
+
+/* -------------------- App Helpers -------------------- */
+// What a replay compares: the receipt without receipt#, clock time or ETA,
+// which legitimately differ between runs.
+string receiptDigest(const Order& o) {
+    ostringstream out;
+    out << o.customerName << " (" << o.dineOption << ")\n";
+    for (const auto& l : o.lines) {
+        out << (l.item ? l.item->name : string("(unknown)")) << " x" << l.quantity
+            << " " << fixed << setprecision(2) << l.subtotal() << "\n";
+    }
+    out << "TOTAL " << fixed << setprecision(2) << o.total();
+    return out.str();
+}
+
+void appendReceiptJson(string& out, const Order& o) {
+    out += "{\"type\":\"receipt\",\"receipt\":";
+    appendUnsigned(out, o.receiptNo);
+    out += ",\"epoch_ms\":";
+    appendUnsigned(out, static_cast<unsigned long long>(
+        chrono::duration_cast<chrono::milliseconds>(o.timestamp.time_since_epoch()).count()));
+    out += ",\"customer\":";
+    appendJsonString(out, o.customerName);
+    out += ",\"dine\":";
+    appendJsonString(out, o.dineOption);
+    if (o.table != NO_TABLE) {
+        out += ",\"table\":";
+        appendUnsigned(out, o.table + 1ULL);
+    }
+    out += ",\"lines\":[";
+    for (size_t i = 0; i < o.lines.size(); ++i) {
+        const OrderLine& l = o.lines[i];
+        if (i) out += ',';
+        out += "{\"item\":";
+        appendJsonString(out, l.item ? l.item->name : string_view("(unknown)"));
+        out += ",\"qty\":";
+        appendUnsigned(out, static_cast<unsigned long long>(max(l.quantity, 0)));
+        out += ",\"subtotal\":";
+        appendFixed(out, l.subtotal());
+        out += '}';
+    }
+    out += "],\"total\":";
+    appendFixed(out, o.total());
+    if (o.etaMinutes >= 0) {
+        out += ",\"eta_minutes\":";
+        appendUnsigned(out, static_cast<unsigned long long>(o.etaMinutes));
+    }
+    out += "}\n";
+}
+
+void emitReceipt(const Order& order) {
+    Output& out = output();
+    string buf = out.acquire();
+    if (out.json()) appendReceiptJson(buf, order);
+    else order.printReceipt(recordStream(buf));
+    writeRecord(std::move(buf));
+}
+
+void printBackstory() {
+    screen() << Colors::TITLE
+        << "Welcome to James' Café — A cozy corner for your calm mornings.\n"
+        << Colors::RESET;
+    screen() << Colors::MUTED
+        << "Here we brew slow, chat quietly, and make every cup with care.\n\n"
+        << Colors::RESET;
+}
+
+// **NEW HELPER FUNCTION**
+bool isCategorySoldOut(Menu& menu, const string& category) {
+    return !menu.anyInStock(category); // walks only this category's span
+}
+
+// **UPDATED FUNCTION**
+void showCategories(Menu& menu, const DietFilter& filter) {
+    screen() << Colors::SUBTLE << "Menu categories:\n" << Colors::RESET;
+    if (filter.active()) {
+        screen() << Colors::MUTED << "(Showing only: " << describeFilter(filter) << ")\n" << Colors::RESET;
+    }
+
+    auto printCategory = [&](int num, const string& name) {
+        screen() << num << ") " << name;
+        if (isCategorySoldOut(menu, name)) {
+            screen() << Colors::SOLD_OUT << " [SOLD OUT]" << Colors::RESET;
+        }
+        screen() << "\n";
+        };
+
+    printCategory(1, "Beverages");
+    printCategory(2, "Snacks");
+    printCategory(3, "Meals");
+    printCategory(4, "Desserts");
+    screen() << "5) Search items by name\n";
+    screen() << "6) Dietary preferences\n";
+    screen() << "7) Browse by price & popularity\n";
+    screen() << "8) Review / edit basket\n";
+    screen() << "0) Finish order\n";
+}
+
+void printAvailable(const vector<Item*>& available) {
+    for (size_t i = 0; i < available.size(); ++i) {
+        screen() << (i + 1) << ") " << available[i]->name
+            << "  ₱ " << fixed << setprecision(2) << available[i]->price
+            << "  (" << available[i]->qty << " left)\n";
+    }
+    screen() << "0) Back to categories\n";
+}
+
+// The listing helpers fill a caller-owned vector and reuse a per-thread
+// filter bitmap, so browsing the menu does not allocate.
+void listAvailableInCategory(Menu& menu, const string& cat, const DietFilter& filter, vector<Item*>& available) {
+    MemScope scope(MemTag::Scratch);
+    static thread_local vector<uint64_t> pass;
+    menu.filter(filter, pass);
+
+    available.clear();
+    for (size_t i = 0; i < menu.size(); ++i) {
+        Item& it = menu.items[i];
+        if (bitTest(pass, i) && it.category == cat && it.qty > 0) available.push_back(&it);
+    }
+    if (available.empty()) {
+        if (filter.active()) {
+            screen() << Colors::MUTED << "(No available items in " << cat << " matching: "
+                << describeFilter(filter) << ")\n" << Colors::RESET;
+        }
+        else {
+            screen() << Colors::MUTED << "(No available items in " << cat << ")\n" << Colors::RESET;
+        }
+        return;
+    }
+    printAvailable(available);
+}
+
+bool containsIgnoreCase(string_view haystack, string_view needle) {
+    auto eq = [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        };
+    return search(haystack.begin(), haystack.end(), needle.begin(), needle.end(), eq) != haystack.end();
+}
+
+// Case-insensitive name search across every category, honouring the filter.
+void searchAvailable(Menu& menu, const string& query, const DietFilter& filter, vector<Item*>& found) {
+    MemScope scope(MemTag::Scratch);
+    static thread_local vector<uint64_t> pass;
+    menu.filter(filter, pass);
+
+    found.clear();
+    for (size_t i = 0; i < menu.size(); ++i) {
+        Item& it = menu.items[i];
+        if (!bitTest(pass, i) || it.qty <= 0) continue;
+        if (containsIgnoreCase(it.name, query)) found.push_back(&it);
+    }
+    if (found.empty()) {
+        screen() << Colors::MUTED << "(No available items matching \"" << query << "\")\n" << Colors::RESET;
+        return;
+    }
+    printAvailable(found);
+}
+
+const char* const CATEGORY_NAMES[] = { "Beverages", "Snacks", "Meals", "Desserts" };
+
+void browseByQuery(Menu& menu, const DietFilter& filter, vector<Item*>& found) {
+    MenuQuery q;
+    q.diet = filter;
+    q.limit = 10;
+    int cat = readIntInRange("Category (1-4, 0 = any): ", 0, 4);
+    if (cat > 0) q.category = CATEGORY_NAMES[cat - 1];
+    int maxPrice = readIntInRange("Max price in ₱ (0 = no limit): ", 0, 1000000);
+    if (maxPrice > 0) q.maxPrice = maxPrice;
+    int sort = readIntInRange("Sort by 1) popularity 2) price: ", 1, 2);
+    q.sort = sort == 1 ? SortBy::Popularity : SortBy::Price;
+
+    {
+        MemScope scope(MemTag::Scratch);
+        menu.query(q, found);
+    }
+    if (found.empty()) {
+        screen() << Colors::MUTED << "(No available items match)\n" << Colors::RESET;
+        return;
+    }
+    printAvailable(found);
+}
+
+void editDietFilter(DietFilter& filter) {
+    while (true) {
+        screen() << Colors::SUBTLE << "Dietary preferences (toggle):\n" << Colors::RESET;
+        for (int i = 0; i < DIET_PRESET_COUNT; ++i) {
+            screen() << (i + 1) << ") [" << (isPresetOn(filter, DIET_PRESETS[i]) ? "x" : " ") << "] "
+                << DIET_PRESETS[i].label << "\n";
+        }
+        screen() << (DIET_PRESET_COUNT + 1) << ") Clear all\n";
+        screen() << "0) Done\n";
+        int choice = readIntInRange("Choose option: ", 0, DIET_PRESET_COUNT + 1);
+        if (choice == 0) break;
+        if (choice == DIET_PRESET_COUNT + 1) { filter = DietFilter(); continue; }
+        const DietPreset& p = DIET_PRESETS[choice - 1];
+        AttrMask& mask = p.required ? filter.mustHave : filter.mustNot;
+        mask ^= p.bit;
+    }
+}
+
+unsigned long long generateReceiptNumber() {
+    static unsigned long long counter = 0ULL;
+    unsigned long long millis = static_cast<unsigned long long>(
+        chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count());
+    // combine time and counter to reduce collisions
+    return (millis % 1000000000ULL) + (++counter);
+}
+
+void showCounterMenu(const OrderTracker& tracker, const TableSeating& tables) {
+    screen() << Colors::ACCENT << "---- Counter ----" << Colors::RESET << "\n";
+    screen() << "1) Serve next customer\n";
+    screen() << "2) Now serving board\n";
+    screen() << "3) Kitchen: start next order (" << tracker.count(OrderStatus::Placed) << " waiting)\n";
+    screen() << "4) Kitchen: mark order ready (" << tracker.count(OrderStatus::Preparing) << " preparing)\n";
+    screen() << "5) Hand over order to customer (" << tracker.count(OrderStatus::Ready) << " ready)\n";
+    screen() << "6) Memory report\n";
+    screen() << "7) Reconcile inventory with journal\n";
+    if (tables.size()) screen() << "8) Tables (" << tables.freeCount() << " of " << tables.size() << " free)\n";
+    screen() << "0) Close for the day\n";
+}
+
+// Blank input selects the oldest order in the expected status.
+uint32_t pickOrder(const OrderTracker& tracker, OrderStatus expected, const string& prompt) {
+    screen() << prompt;
+    string line = readLineTrimmed();
+    uint32_t idx = NO_ORDER;
+    if (line.empty()) {
+        idx = tracker.oldest(expected);
+        if (idx == NO_ORDER) screen() << Colors::MUTED << "(No orders " << statusName(expected) << ")\n" << Colors::RESET;
+        return idx;
+    }
+    idx = tracker.find(strtoull(line.c_str(), nullptr, 10));
+    if (idx == NO_ORDER) screen() << Colors::ERR << "No order with receipt# " << line << ".\n" << Colors::RESET;
+    return idx;
+}
+
+void runCounterAction(int action, vector<Order>& orders, OrderTracker& tracker, WaitTimeEstimator& eta) {
+    if (action == 2) {
+        tracker.renderBoard();
+        return;
+    }
+    OrderStatus expected = action == 3 ? OrderStatus::Placed
+        : action == 4 ? OrderStatus::Preparing : OrderStatus::Ready;
+    uint32_t idx = action == 3 ? tracker.oldest(expected)
+        : pickOrder(tracker, expected, "Receipt# (blank = oldest " + string(statusName(expected)) + "): ");
+    if (idx == NO_ORDER) {
+        if (action == 3) screen() << Colors::MUTED << "(No orders waiting)\n" << Colors::RESET;
+        return;
+    }
+    Order& o = orders[idx];
+    if (o.status != expected) {
+        screen() << Colors::ERR << "Order #" << o.receiptNo << " is " << statusName(o.status) << ", not "
+            << statusName(expected) << ".\n" << Colors::RESET;
+        return;
+    }
+    tracker.advance(idx);
+    if (o.status == OrderStatus::Ready) {
+        eta.onReady(o, chrono::duration<double>(chrono::steady_clock::now() - o.prepStartedAt).count());
+    }
+    screen() << Colors::HIGHL << "Order #" << o.receiptNo << " (" << o.customerName << ") is now "
+        << statusName(o.status) << "." << Colors::RESET << "\n";
+}
+
+void loadDefaultMenu(Menu& menu) {
+    menu.reserve(DEFAULT_MENU_SIZE);
+    for (const MenuEntry& e : DEFAULT_MENU) menu.add(Item(e.name, e.price, e.qty, e.category), e.attrs);
+    menu.useFixedIndex(findDefaultItem);
+    menu.buildIndexes();
+}
+
+// Everything a trading day accumulates, plus the checkout step shared by
+// the interactive loop and the benchmarks.
+struct CafeDay {
+    Menu& menu;
+    vector<Order> allOrders;
+    OrderTracker tracker;
+    WaitTimeEstimator eta;
+    OrderJournal journal;
+    AllocReport allocReport;
+    OrderSketches sketches;
+    vector<pair<int, int>> opening; // qty and sold per item before the journal, for reconciliation
+    unique_ptr<OrderStore> store;   // where checkout records orders: the journal unless --store says otherwise
+    TableSeating tables;            // empty unless --tables
+    int customersServed = 0;
+
+    explicit CafeDay(Menu& m) : menu(m), tracker(allOrders), eta(m), store(make_unique<JournalStore>(journal, m)) {
+        MemScope scope(MemTag::Orders);
+        allOrders.reserve(1024);
+        opening.reserve(m.size());
+        for (const auto& it : m) opening.emplace_back(it.qty, it.sold);
+    }
+
+    void checkout(Order& order) {
+        AllocPhaseScope phase(AllocPhase::Checkout);
+        MemScope scope(MemTag::Orders);
+        eta.onPlaced(order);
+        if (order.party > 0) seat(order);
+        const bool saved = store->saveOrder(order);
+        emitReceipt(order);
+        if (!saved) {
+            screen() << Colors::ERR << "Order #" << order.receiptNo << " is NOT saved: the " << store->name()
+                << " write failed. Keep a copy of the receipt and record it by hand.\n" << Colors::RESET;
+        }
+        if (sessionTape().capturing()) sessionTape().orderFinished(receiptDigest(order));
+        int units = 0;
+        for (const auto& l : order.lines) units += l.quantity;
+        sketches.add(order.customerName, units, order.total());
+        logEvent(Event::OrderCommitted, {}, units, static_cast<int32_t>(order.lines.size()), order.receiptNo,
+            order.total(), order.customerName);
+        allOrders.push_back(std::move(order));
+        tracker.track(static_cast<uint32_t>(allOrders.size() - 1));
+        customersServed++;
+        allocReport.endOrder();
+    }
+
+    // The till is about to wait on the cashier: ends the store's batch so
+    // every order checked out so far is durable, and says so if it is not.
+    void settle() {
+        const bool wasOk = store->ok();
+        store->commit();
+        if (wasOk && !store->ok() && !allOrders.empty()) {
+            screen() << Colors::ERR << "Orders up to #" << allOrders.back().receiptNo << " may NOT be saved: the "
+                << store->name() << " commit failed. Keep copies of their receipts.\n" << Colors::RESET;
+        }
+    }
+
+    // Gives an Eat-In party the best-fitting free table until its food is
+    // ready and eaten; leaves order.table at NO_TABLE if none is free.
+    void seat(Order& order) {
+        const auto now = chrono::steady_clock::now();
+        tables.releaseDue(now);
+        order.table = tables.seat(static_cast<uint32_t>(allOrders.size()), order.party,
+            now + chrono::minutes(max(order.etaMinutes, 0) + tables.dineMinutes()));
+        if (order.table == NO_TABLE) {
+            screen() << Colors::ERR << "No free table seats " << order.party << " right now; seat them when one clears.\n"
+                << Colors::RESET;
+        }
+    }
+
+    // Counter action 8: the floor, and clearing a table that left early.
+    void manageTables() {
+        const auto now = chrono::steady_clock::now();
+        tables.releaseDue(now);
+        tables.renderFloor(allOrders, now);
+        screen() << "Clear table # (blank = back): ";
+        const string line = readLineTrimmed();
+        if (line.empty()) return;
+        const unsigned long n = strtoul(line.c_str(), nullptr, 10);
+        if (n >= 1 && tables.release(static_cast<uint32_t>(n - 1))) {
+            screen() << Colors::HIGHL << "Table " << n << " is free." << Colors::RESET << "\n";
+        }
+        else screen() << Colors::ERR << "Table " << line << " is not taken.\n" << Colors::RESET;
+    }
+
+    // Pulls HQ's menu changes between customers. The item table may move,
+    // so order lines are re-pointed by index; reconciliation's opening
+    // stock follows the withdrawals and additions. Returns the items
+    // changed, or -1.
+    long long syncMenu(MenuSync& sync, string& error) {
+        MenuDelta delta;
+        if (!sync.fetch(delta, error)) return error.empty() ? 0 : -1;
+        MemScope scope(MemTag::Orders);
+        vector<uint32_t> lineItems;
+        for (const auto& o : allOrders) {
+            for (const auto& l : o.lines) lineItems.push_back(l.item ? static_cast<uint32_t>(menu.indexOf(l.item)) : NO_ORDER);
+        }
+        vector<int> before;
+        before.reserve(menu.size());
+        for (const auto& it : menu) before.push_back(it.qty);
+
+        const size_t changed = sync.apply(menu, delta);
+        size_t k = 0;
+        for (auto& o : allOrders) {
+            for (auto& l : o.lines) {
+                l.item = lineItems[k] == NO_ORDER ? nullptr : &menu.items[lineItems[k]];
+                ++k;
+            }
+        }
+        for (size_t i = 0; i < menu.size(); ++i) {
+            if (i < before.size()) opening[i].first += menu.items[i].qty - before[i];
+            else opening.emplace_back(menu.items[i].qty, menu.items[i].sold);
+        }
+        return static_cast<long long>(changed);
+    }
+};
+
+// Live heap by owning structure, straight from the block headers.
+void printMemoryReport(const Menu& menu, const CafeDay& day) {
+    const double items = static_cast<double>(max<size_t>(menu.size(), 1));
+    const double orders = static_cast<double>(max<size_t>(day.allOrders.size(), 1));
+    long long totalBytes = 0, totalBlocks = 0;
+
+    screen() << Colors::TITLE << "\n=== Memory Footprint (live heap) ===\n" << Colors::RESET;
+    screen() << left << setw(18) << "structure" << right << setw(14) << "bytes" << setw(10) << "blocks"
+        << setw(16) << "per unit" << "\n";
+    for (int t = 0; t < MEM_TAGS; ++t) {
+        long long bytes = 0, blocks = 0;
+        MemStats::live(t, bytes, blocks);
+        totalBytes += bytes;
+        totalBlocks += blocks;
+        MemTag tag = static_cast<MemTag>(t);
+        screen() << left << setw(18) << MEM_TAG_NAMES[t] << right << setw(14) << bytes << setw(10) << blocks;
+        if (tag == MemTag::Menu || tag == MemTag::MenuIndexes || tag == MemTag::WaitTimes) {
+            screen() << setw(10) << fixed << setprecision(1) << bytes / items << " B/item";
+        }
+        else if (tag == MemTag::Orders || tag == MemTag::OrderBoard || tag == MemTag::Journal) {
+            screen() << setw(10) << fixed << setprecision(1) << bytes / orders << " B/order";
+        }
+        screen() << "\n";
+    }
+    screen() << left << setw(18) << "total" << right << setw(14) << totalBytes << setw(10) << totalBlocks << "\n";
+    screen() << Colors::MUTED << "(" << menu.size() << " items, " << day.allOrders.size() << " orders; block headers add "
+        << totalBlocks * static_cast<long long>(sizeof(BlockHeader)) << " bytes)\n\n" << Colors::RESET;
+}
+
+// Day totals, sketch percentiles, best seller and what is left on the shelf.
+void emitSummary(Menu& menu, CafeDay& day) {
+    double revenue = 0.0;
+    int itemsSold = 0;
+    for (auto& o : day.allOrders) revenue += o.total();
+    for (auto& it : menu) itemsSold += it.sold;
+    const Item* best = nullptr;
+    for (auto& it : menu) if (!best || it.sold > best->sold) best = &it;
+    if (best && best->sold <= 0) best = nullptr;
+    const bool sketched = day.sketches.basketSize.count() > 0;
+
+    Output& out = output();
+    string buf = out.acquire();
+    if (out.json()) {
+        auto appendInt = [&](long long v) {
+            if (v < 0) { buf += '-'; v = -v; }
+            appendUnsigned(buf, static_cast<unsigned long long>(v));
+        };
+        buf += "{\"type\":\"summary\",\"customers_served\":";
+        appendInt(day.customersServed);
+        buf += ",\"revenue\":";
+        appendFixed(buf, revenue);
+        buf += ",\"items_sold\":";
+        appendInt(itemsSold);
+        if (sketched) {
+            buf += ",\"distinct_customers\":";
+            appendInt(llround(day.sketches.customers.estimate()));
+            buf += ",\"basket_p50\":";
+            appendFixed(buf, day.sketches.basketSize.quantile(0.5), 1);
+            buf += ",\"basket_p95\":";
+            appendFixed(buf, day.sketches.basketSize.quantile(0.95), 1);
+            buf += ",\"ticket_p50\":";
+            appendFixed(buf, day.sketches.ticketValue.quantile(0.5));
+            buf += ",\"ticket_p95\":";
+            appendFixed(buf, day.sketches.ticketValue.quantile(0.95));
+        }
+        buf += ",\"best_seller\":";
+        if (best) {
+            buf += "{\"item\":";
+            appendJsonString(buf, best->name);
+            buf += ",\"sold\":";
+            appendInt(best->sold);
+            buf += '}';
+        }
+        else buf += "null";
+        buf += ",\"inventory\":[";
+        for (size_t i = 0; i < menu.size(); ++i) {
+            if (i) buf += ',';
+            buf += "{\"item\":";
+            appendJsonString(buf, menu.items[i].name);
+            buf += ",\"qty\":";
+            appendInt(menu.items[i].qty);
+            buf += '}';
+        }
+        buf += "]}\n";
+    }
+    else {
+        ostream& os = recordStream(buf);
+        os << Colors::TITLE << "\n=== Daily Summary ===\n" << Colors::RESET;
+        os << "Customers served: " << day.customersServed << "\n";
+        os << "Total revenue: ₱ " << fixed << setprecision(2) << revenue << "\n";
+        os << "Total items sold: " << itemsSold << "\n";
+        if (sketched) day.sketches.print(os);
+        if (best) os << "Best seller: " << best->name << " (" << best->sold << " sold)\n";
+        else os << "No sales recorded.\n";
+        os << "\nRemaining inventory:\n";
+        for (auto& it : menu) os << "- " << it.name << " : " << it.qty << " left\n";
+    }
+    writeRecord(std::move(buf));
+}
+
+/* -------------------- Inventory Reconciliation -------------------- */
+// Day-close check that live stock is what the recorded orders imply. The
+// live tree, maintained sale by sale, is compared with one built from the
+// opening stock plus every journaled sale (read mostly from segment
+// footers), or with a tree file saved by a standby.
+
+// Tree file: "JCMT" | u32 version | u32 items | {u16 length, name}... | tree
+bool saveStockTree(const string& path, Menu& menu) {
+    string out("JCMT", 4);
+    appendPod(out, uint32_t(1));
+    appendPod(out, static_cast<uint32_t>(menu.size()));
+    for (const auto& it : menu) {
+        appendPod(out, static_cast<uint16_t>(it.name.size()));
+        out.append(it.name.data(), it.name.size());
+    }
+    menu.stockTree().serialize(out);
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(out.data(), static_cast<streamsize>(out.size()));
+    return static_cast<bool>(file);
+}
+
+bool loadStockTree(const string& path, InventoryTree& tree, vector<string>& names) {
+    string data;
+    if (!readFileRange(path, 0, static_cast<size_t>(fileSize(path)), data) || data.compare(0, 4, "JCMT") != 0) return false;
+    const char* p = data.data() + 4;
+    const char* end = data.data() + data.size();
+    uint32_t version = 0, count = 0;
+    if (!takePod(p, end, version) || version != 1 || !takePod(p, end, count)) return false;
+    names.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint16_t len = 0;
+        if (!takePod(p, end, len) || static_cast<size_t>(end - p) < len) return false;
+        names.emplace_back(p, len);
+        p += len;
+    }
+    return tree.deserialize(p, end) && tree.size() == count;
+}
+
+void printDivergence(const vector<size_t>& items, size_t comparisons, size_t total,
+    const function<void(size_t)>& describe) {
+    if (items.empty()) {
+        screen() << Colors::HIGHL << "All " << total << " items match (" << comparisons << (comparisons == 1 ? " comparison" : " comparisons") << ").\n" << Colors::RESET;
+        return;
+    }
+    screen() << Colors::ERR << items.size() << " of " << total << " items differ (" << comparisons
+        << " comparisons):\n" << Colors::RESET;
+    for (size_t i : items) describe(i);
+}
+
+void reconcileWithJournal(Menu& menu, CafeDay& day) {
+    screen() << Colors::TITLE << "\n=== Inventory Reconciliation ===\n" << Colors::RESET;
+    if (!day.journal.isOpen()) {
+        screen() << Colors::MUTED << "(No journal: start with --journal <file> to reconcile)\n" << Colors::RESET;
+        return;
+    }
+    string error;
+    vector<long long> sold;
+    long long orders = sumJournal(day.journal.path(), menu, sold, error);
+    if (orders < 0) {
+        screen() << Colors::ERR << "Cannot read journal: " << error << "\n" << Colors::RESET;
+        return;
+    }
+    InventoryTree expected;
+    expected.assign(menu.size());
+    for (size_t i = 0; i < menu.size(); ++i) {
+        expected.set(i, InventoryTree::leaf(menu.items[i].name, day.opening[i].first - static_cast<int>(sold[i]),
+            day.opening[i].second + static_cast<int>(sold[i])));
+    }
+    expected.rebuild();
+
+    const InventoryTree& live = menu.stockTree();
+    vector<size_t> differ;
+    size_t comparisons = 0;
+    live.diff(expected, differ, comparisons);
+    screen() << "Journal: " << orders << " orders. Roots: live " << hex << live.root() << ", journal "
+        << expected.root() << dec << "\n";
+    printDivergence(differ, comparisons, menu.size(), [&](size_t i) {
+        const Item& it = menu.items[i];
+        screen() << "- " << it.name << ": live " << it.qty << " left / " << it.sold << " sold, journal "
+            << day.opening[i].first - sold[i] << " left / " << day.opening[i].second + sold[i] << " sold\n";
+        });
+}
+
+// --reconcile <tree> <tree>: primary against standby, from --tree-out files.
+int reconcileTreeFiles(const string& a, const string& b) {
+    InventoryTree ta, tb;
+    vector<string> na, nb;
+    if (!loadStockTree(a, ta, na) || !loadStockTree(b, tb, nb)) {
+        cerr << "Cannot read inventory tree: " << (na.empty() ? a : b) << "\n";
+        return 1;
+    }
+    vector<size_t> differ;
+    size_t comparisons = 0;
+    if (na != nb || !ta.diff(tb, differ, comparisons)) {
+        cerr << "The trees cover different menus\n";
+        return 1;
+    }
+    printDivergence(differ, comparisons, na.size(), [&](size_t i) { screen() << "- " << na[i] << "\n"; });
+    return differ.empty() ? 0 : 3;
+}
+
+/* ---- Basket editing ---- */
+// Lines take their stock when added, so an edit moves only the difference
+// through adjustStock(). The stock check and the change happen together
+// under the menu guard: a register can correct a line while others sell
+// the same items, without re-checking the rest of the order.
+
+// Takes `delta` units of the item (negative returns them). Returns the
+// stock left, or -1 with nothing changed if fewer than `delta` remain.
+int takeStock(Menu& menu, Item* item, int delta) {
+    lock_guard<mutex> lock(menu.guard);
+    if (delta > item->qty) return -1;
+    if (delta != 0) menu.adjustStock(menu.indexOf(item), -delta, delta);
+    return item->qty;
+}
+
+bool addLine(Menu& menu, Order& order, Item* item, int qty) {
+    const int left = takeStock(menu, item, qty);
+    if (left < 0) return false;
+    order.lines.push_back(OrderLine{ item, qty });
+    logEvent(Event::ItemAdded, item->name, qty, left);
+    return true;
+}
+
+// A quantity of 0 removes the line. False if the stock can't cover an
+// increase; the line is then left as it was.
+bool setLineQuantity(Menu& menu, Order& order, size_t line, int qty) {
+    OrderLine& l = order.lines[line];
+    const int delta = qty - l.quantity;
+    if (l.item && delta != 0) {
+        const int left = takeStock(menu, l.item, delta);
+        if (left < 0) return false;
+        logEvent(Event::LineChanged, l.item->name, delta, left);
+    }
+    if (qty == 0) order.lines.erase(order.lines.begin() + static_cast<long>(line));
+    else l.quantity = qty;
+    return true;
+}
+
+// Folds lines of the same item at the same price into the first of them.
+// Stock is untouched. Returns the number of lines removed.
+size_t mergeDuplicateLines(Order& order) {
+    vector<OrderLine>& lines = order.lines;
+    size_t kept = 0;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        size_t k = 0;
+        while (k < kept && !(lines[k].item == lines[i].item && lines[k].price == lines[i].price)) ++k;
+        if (k < kept) lines[k].quantity += lines[i].quantity;
+        else lines[kept++] = lines[i];
+    }
+    const size_t removed = lines.size() - kept;
+    lines.resize(kept);
+    return removed;
+}
+
+// Puts every line's stock back and empties the basket.
+void returnBasket(Menu& menu, Order& order) {
+    for (const auto& l : order.lines) {
+        if (!l.item) continue;
+        const int left = takeStock(menu, l.item, -l.quantity);
+        logEvent(Event::LineChanged, l.item->name, -l.quantity, left);
+    }
+    order.lines.clear();
+}
+
+void printBasket(const Order& order) {
+    screen() << Colors::SUBTLE << "Your basket:\n" << Colors::RESET;
+    for (size_t i = 0; i < order.lines.size(); ++i) {
+        const OrderLine& l = order.lines[i];
+        screen() << (i + 1) << ") " << l.quantity << " x " << left << setw(28)
+            << (l.item ? l.item->name : string_view("(unknown)")) << right
+            << "₱ " << fixed << setprecision(2) << l.subtotal() << "\n";
+    }
+    screen() << Colors::HIGHL << "TOTAL: ₱ " << fixed << setprecision(2) << order.total() << Colors::RESET << "\n";
+}
+
+void editBasket(Menu& menu, Order& order) {
+    while (true) {
+        if (order.lines.empty()) {
+            screen() << Colors::MUTED << "(The basket is empty)\n" << Colors::RESET;
+            return;
+        }
+        printBasket(order);
+        screen() << "1) Change quantity\n2) Remove a line\n3) Merge duplicate lines\n4) Cancel the order\n0) Back\n";
+        const int action = readIntInRange("Choose action (0-4): ", 0, 4);
+        if (action == 0 || inputEnded()) return;
+
+        if (action == 3) {
+            const size_t merged = mergeDuplicateLines(order);
+            screen() << Colors::MUTED << "(" << merged << (merged == 1 ? " line merged)\n" : " lines merged)\n")
+                << Colors::RESET;
+            continue;
+        }
+        if (action == 4) {
+            if (readYesNo("Return every item to stock and cancel? (Y/N): ")) returnBasket(menu, order);
+            if (inputEnded()) return;
+            continue;
+        }
+
+        const size_t line = static_cast<size_t>(readIntInRange("Line number: ", 1, static_cast<int>(order.lines.size())) - 1);
+        if (inputEnded()) return;
+        OrderLine& l = order.lines[line];
+        int qty = 0;
+        if (action == 1) {
+            const int most = l.quantity + (l.item ? l.item->qty : 0);
+            qty = readIntInRange("New quantity (0 removes the line): ", 0, most);
+            if (inputEnded()) return;
+        }
+        const string name(l.item ? l.item->name : string_view("(unknown)"));
+        if (!setLineQuantity(menu, order, line, qty)) {
+            screen() << Colors::ERR << "Not enough " << name << " left for that.\n" << Colors::RESET;
+        }
+        else if (qty == 0) screen() << Colors::HIGHL << name << " removed from order." << Colors::RESET << "\n";
+        else screen() << Colors::HIGHL << "Now " << qty << " x " << name << "." << Colors::RESET << "\n";
+    }
+}
+
+// One customer's transaction up to checkout: name, dine option (and party
+// size, if there are tables up to `maxParty`) and the category loop.
+// Returns false if input ran out before a name was given.
+bool takeOrder(Menu& menu, Order& order, int maxParty = 0) {
+    MemScope scope(MemTag::Orders);
+    order.lines.reserve(4);
+
+    while (true) {
+        AllocPhaseScope phase(AllocPhase::Name);
+        screen() << "Enter customer name: ";
+        string name = readLineTrimmed();
+        if (inputEnded()) break;
+        if (name.empty()) {
+            screen() << Colors::ERR << "Name cannot be empty.\n" << Colors::RESET;
+            continue;
+        }
+        blankSeparators(name);
+        order.customerName = std::move(name);
+        break;
+    }
+    if (inputEnded()) return false;
+
+    AllocPhaseScope dinePhase(AllocPhase::DineOption);
+    bool isEatIn = readYesNo("Dine option - Eat in? or Take-Out (Y/N): ");
+    order.dineOption = isEatIn ? "Eat-In" : "Take-Out";
+    if (isEatIn && maxParty > 0) order.party = readIntInRange("Party size: ", 1, maxParty);
+
+    DietFilter filter;
+    static thread_local vector<Item*> available;
+
+    while (true) {
+        AllocPhaseScope browsePhase(AllocPhase::Browse);
+        showCategories(menu, filter); // **UPDATED CALL**
+        int catChoice = readIntInRange("Choose category (0-8): ", 0, 8);
+        if (catChoice == 0) break;
+
+        if (catChoice == 8) {
+            editBasket(menu, order);
+            if (inputEnded()) break;
+            continue;
+        }
+
+        if (catChoice == 6) {
+            editDietFilter(filter);
+            continue;
+        }
+
+        if (catChoice == 5) {
+            screen() << "Search for: ";
+            string query = readLineTrimmed();
+            if (query.empty()) continue;
+            searchAvailable(menu, query, filter, available);
+            if (available.empty()) continue;
+        }
+        else if (catChoice == 7) {
+            browseByQuery(menu, filter, available);
+            if (available.empty()) continue;
+        }
+        else {
+            string category;
+            switch (catChoice) {
+            case 1: category = "Beverages"; break;
+            case 2: category = "Snacks"; break;
+            case 3: category = "Meals"; break;
+            case 4: category = "Desserts"; break;
+            default: category = ""; break;
+            }
+            if (category.empty()) continue;
+
+            // **NEW LOGIC: Check if the selected category is sold out**
+            if (isCategorySoldOut(menu, category)) {
+                screen() << Colors::ERR << "Sorry, " << category << " is completely sold out for today.\n" << Colors::RESET;
+                continue; // Go back to category selection
+            }
+
+            listAvailableInCategory(menu, category, filter, available);
+            // Not redundant once a dietary filter is active: stock may remain but match nothing
+            if (available.empty()) continue;
+        }
+
+        int itemChoice = readIntInRange("Select item number (0 to go back): ", 0, static_cast<int>(available.size()));
+        if (itemChoice == 0) continue;
+
+        Item* chosen = available[itemChoice - 1];
+        if (!chosen) { screen() << Colors::ERR << "Unexpected error selecting item.\n" << Colors::RESET; continue; }
+
+        AllocPhaseScope addPhase(AllocPhase::AddLine);
+        int qty = readIntInRange("Enter quantity: ", 1, chosen->qty);
+        if (inputEnded()) break;
+
+        if (!addLine(menu, order, chosen, qty)) {
+            screen() << Colors::ERR << "Only " << chosen->qty << " " << chosen->name << " left.\n" << Colors::RESET;
+            continue;
+        }
+
+        screen() << Colors::HIGHL << qty << " x " << chosen->name << " added to order." << Colors::RESET << "\n";
+
+        bool addMore = readYesNo("Add more items? (Y/N): ");
+        if (!addMore) {
+            bool continueOrdering = readYesNo("Continue ordering (another category)? (Y/N): ");
+            if (!continueOrdering) break;
+        }
+    }
+    return true;
+}
+
+/* -------------------- Wire Protocol -------------------- */
+// Register <-> server messages, read in place from the receive buffer.
+// A frame is
+//   u32 length (of what follows, a multiple of 8) | u16 type | u16 version | body
+// and a body is a fixed header, an array of fixed-size entries, then the
+// string bytes they point at as (offset from body start, length). All
+// little-endian and naturally aligned, so a field is one load; checking a
+// frame is one pass over its counts and offsets, and nothing is copied
+// out. Items are referred to by index into the menu snapshot whose
+// version the message carries.
+enum class WireType : uint16_t { MenuSnapshot = 1, OrderSubmit = 2, Receipt = 3, StockDelta = 4 };
+const uint16_t WIRE_VERSION = 1;
+const uint32_t WIRE_MAX_FRAME = 16u << 20;
+const uint32_t WIRE_NO_ITEM = 0xFFFFFFFFu; // an order line whose item is gone
+
+struct WireFrameHeader {
+    uint32_t length;
+    uint16_t type;
+    uint16_t version;
+};
+
+struct WireString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct WireMenuHeader {
+    uint64_t menuVersion;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct WireMenuItem {
+    WireString name;
+    WireString category;
+    double price;
+    int32_t qty;
+    int32_t sold;
+    uint16_t attrs;
+    uint16_t reserved[3];
+};
+
+struct WireOrderHeader {
+    uint64_t menuVersion;
+    uint64_t clientRef;   // the register's own id for the submission, echoed back
+    WireString customer;
+    uint8_t eatIn;
+    uint8_t reserved[3];
+    uint32_t count;
+};
+
+struct WireOrderLine {
+    uint32_t item;
+    int32_t qty;
+};
+
+struct WireReceiptHeader {
+    uint64_t receiptNo;
+    uint64_t epochMs;
+    uint64_t menuVersion;
+    double total;
+    WireString customer;
+    uint8_t eatIn;
+    uint8_t reserved;
+    int16_t etaMinutes;   // -1: no estimate
+    uint32_t count;
+};
+
+struct WireReceiptLine {
+    uint32_t item;
+    int32_t qty;
+    double subtotal;
+};
+
+struct WireStockHeader {
+    uint64_t menuVersion;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct WireStockEntry {
+    uint32_t item;
+    int32_t qtyDelta;
+    int32_t soldDelta;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(WireFrameHeader) == 8 && sizeof(WireMenuHeader) == 16 && sizeof(WireMenuItem) == 40
+    && sizeof(WireOrderHeader) == 32 && sizeof(WireOrderLine) == 8 && sizeof(WireReceiptHeader) == 48
+    && sizeof(WireReceiptLine) == 16 && sizeof(WireStockHeader) == 16 && sizeof(WireStockEntry) == 16,
+    "wire layouts are fixed");
+
+// The strings each fixed part points at, for bounds checking.
+template <typename Fn> void wireStrings(const WireMenuHeader&, Fn) {}
+template <typename Fn> void wireStrings(const WireMenuItem& e, Fn fn) { fn(e.name); fn(e.category); }
+template <typename Fn> void wireStrings(const WireOrderHeader& h, Fn fn) { fn(h.customer); }
+template <typename Fn> void wireStrings(const WireOrderLine&, Fn) {}
+template <typename Fn> void wireStrings(const WireReceiptHeader& h, Fn fn) { fn(h.customer); }
+template <typename Fn> void wireStrings(const WireReceiptLine&, Fn) {}
+template <typename Fn> void wireStrings(const WireStockHeader&, Fn) {}
+template <typename Fn> void wireStrings(const WireStockEntry&, Fn) {}
+
+template <typename T>
+T wireLoad(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T)); // a plain load on the aligned, little-endian targets we run on
+    return v;
+}
+
+// One complete frame inside the receive buffer.
+struct WireFrame {
+    WireType type = WireType::MenuSnapshot;
+    const char* body = nullptr;
+    size_t size = 0;
+};
+
+// Takes the next frame off the front of a byte stream. Returns the bytes
+// it spans, 0 if the frame is not complete yet, or -1 if the stream is
+// not valid (unknown type or version, impossible length).
+long long wireNextFrame(const char* data, size_t n, WireFrame& frame) {
+    if (n < sizeof(WireFrameHeader)) return 0;
+    const WireFrameHeader h = wireLoad<WireFrameHeader>(data);
+    if (h.version != WIRE_VERSION || h.length < 4 || h.length > WIRE_MAX_FRAME || (h.length + 4) % 8 != 0) return -1;
+    if (h.type < static_cast<uint16_t>(WireType::MenuSnapshot) || h.type > static_cast<uint16_t>(WireType::StockDelta)) return -1;
+    if (n < 4 + static_cast<size_t>(h.length)) return 0;
+    frame.type = static_cast<WireType>(h.type);
+    frame.body = data + sizeof(WireFrameHeader);
+    frame.size = h.length - 4;
+    return 4 + static_cast<long long>(h.length);
+}
+
+// A message of one header and `count` entries, read straight from the
+// frame. check() once; after that every accessor stays in bounds. A frame
+// of another type fails check().
+template <WireType Type, typename Header, typename Entry>
+class WireView {
+public:
+    explicit WireView(const WireFrame& f) : frame(f) {}
+
+    bool check() const {
+        if (frame.type != Type || frame.size < sizeof(Header)) return false;
+        const Header h = header();
+        if ((frame.size - sizeof(Header)) / sizeof(Entry) < h.count) return false;
+        bool ok = true;
+        auto inBounds = [&](WireString s) {
+            ok = ok && s.offset <= frame.size && s.length <= frame.size - s.offset;
+        };
+        wireStrings(h, inBounds);
+        for (uint32_t i = 0; i < h.count && ok; ++i) wireStrings((*this)[i], inBounds);
+        return ok;
+    }
+
+    Header header() const { return wireLoad<Header>(frame.body); }
+    uint32_t size() const { return header().count; }
+    Entry operator[](uint32_t i) const { return wireLoad<Entry>(frame.body + sizeof(Header) + i * sizeof(Entry)); }
+    string_view text(WireString s) const { return string_view(frame.body + s.offset, s.length); }
+
+private:
+    WireFrame frame;
+};
+
+using MenuSnapshotView = WireView<WireType::MenuSnapshot, WireMenuHeader, WireMenuItem>;
+using OrderSubmitView = WireView<WireType::OrderSubmit, WireOrderHeader, WireOrderLine>;
+using ReceiptView = WireView<WireType::Receipt, WireReceiptHeader, WireReceiptLine>;
+using StockDeltaView = WireView<WireType::StockDelta, WireStockHeader, WireStockEntry>;
+
+// Appends one frame: reserve() the fixed parts, fill them with put(),
+// append strings with text(), then finish().
+class WireWriter {
+public:
+    WireWriter(string& out, WireType type) : out(out), start(out.size()) {
+        WireFrameHeader h{ 0, static_cast<uint16_t>(type), WIRE_VERSION };
+        out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+        body = out.size();
+    }
+
+    void reserve(size_t bytes) { out.resize(body + bytes); }
+
+    template <typename T>
+    void put(size_t at, const T& v) { memcpy(&out[body + at], &v, sizeof(T)); }
+
+    WireString text(string_view s) {
+        WireString w{ static_cast<uint32_t>(out.size() - body), static_cast<uint32_t>(s.size()) };
+        out.append(s.data(), s.size());
+        return w;
+    }
+
+    void finish() {
+        out.append((8 - (out.size() - start) % 8) % 8, '\0');
+        const uint32_t length = static_cast<uint32_t>(out.size() - start - 4);
+        memcpy(&out[start], &length, sizeof(length));
+    }
+
+private:
+    string& out;
+    size_t start, body;
+};
+
+void encodeMenuSnapshot(const Menu& menu, uint64_t menuVersion, string& out) {
+    WireWriter w(out, WireType::MenuSnapshot);
+    const uint32_t n = static_cast<uint32_t>(menu.size());
+    w.reserve(sizeof(WireMenuHeader) + n * sizeof(WireMenuItem));
+    w.put(0, WireMenuHeader{ menuVersion, n, 0 });
+    for (uint32_t i = 0; i < n; ++i) {
+        const Item& it = menu.items[i];
+        WireMenuItem e{};
+        e.name = w.text(it.name);
+        e.category = w.text(it.category);
+        e.price = it.price;
+        e.qty = it.qty;
+        e.sold = it.sold;
+        e.attrs = menu.attrs[i];
+        w.put(sizeof(WireMenuHeader) + i * sizeof(WireMenuItem), e);
+    }
+    w.finish();
+}
+
+void encodeOrderSubmit(const Order& o, const Menu& menu, uint64_t menuVersion, uint64_t clientRef, string& out) {
+    WireWriter w(out, WireType::OrderSubmit);
+    const uint32_t n = static_cast<uint32_t>(o.lines.size());
+    w.reserve(sizeof(WireOrderHeader) + n * sizeof(WireOrderLine));
+    WireOrderHeader h{};
+    h.menuVersion = menuVersion;
+    h.clientRef = clientRef;
+    h.customer = w.text(o.customerName);
+    h.eatIn = o.dineOption == "Eat-In";
+    h.count = n;
+    w.put(0, h);
+    for (uint32_t i = 0; i < n; ++i) {
+        const OrderLine& ol = o.lines[i];
+        WireOrderLine l{ ol.item ? static_cast<uint32_t>(menu.indexOf(ol.item)) : WIRE_NO_ITEM, ol.quantity };
+        w.put(sizeof(WireOrderHeader) + i * sizeof(WireOrderLine), l);
+    }
+    w.finish();
+}
+
+void encodeReceipt(const Order& o, const Menu& menu, uint64_t menuVersion, string& out) {
+    WireWriter w(out, WireType::Receipt);
+    const uint32_t n = static_cast<uint32_t>(o.lines.size());
+    w.reserve(sizeof(WireReceiptHeader) + n * sizeof(WireReceiptLine));
+    WireReceiptHeader h{};
+    h.receiptNo = o.receiptNo;
+    h.epochMs = static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(o.timestamp.time_since_epoch()).count());
+    h.menuVersion = menuVersion;
+    h.total = o.total();
+    h.customer = w.text(o.customerName);
+    h.eatIn = o.dineOption == "Eat-In";
+    h.etaMinutes = static_cast<int16_t>(max(-1, min(o.etaMinutes, 32767)));
+    h.count = n;
+    w.put(0, h);
+    for (uint32_t i = 0; i < n; ++i) {
+        const OrderLine& l = o.lines[i];
+        WireReceiptLine e{ l.item ? static_cast<uint32_t>(menu.indexOf(l.item)) : WIRE_NO_ITEM, l.quantity, l.subtotal() };
+        w.put(sizeof(WireReceiptHeader) + i * sizeof(WireReceiptLine), e);
+    }
+    w.finish();
+}
+
+void encodeStockDelta(uint64_t menuVersion, const vector<WireStockEntry>& deltas, string& out) {
+    WireWriter w(out, WireType::StockDelta);
+    const uint32_t n = static_cast<uint32_t>(deltas.size());
+    w.reserve(sizeof(WireStockHeader) + n * sizeof(WireStockEntry));
+    w.put(0, WireStockHeader{ menuVersion, n, 0 });
+    for (uint32_t i = 0; i < n; ++i) w.put(sizeof(WireStockHeader) + i * sizeof(WireStockEntry), deltas[i]);
+    w.finish();
+}
+
+// Applies a checked stock delta from the server; false if it was built
+// against another menu version or names an item this menu lacks. Runs
+// under the menu guard, so registers selling meanwhile see all of it or
+// none.
+bool applyStockDelta(Menu& menu, uint64_t menuVersion, const StockDeltaView& v) {
+    if (v.header().menuVersion != menuVersion) return false;
+    lock_guard<mutex> lock(menu.guard);
+    for (uint32_t i = 0; i < v.size(); ++i) {
+        if (v[i].item >= menu.size()) return false;
+    }
+    for (uint32_t i = 0; i < v.size(); ++i) {
+        const WireStockEntry e = v[i];
+        menu.adjustStock(e.item, e.qtyDelta, e.soldDelta);
+    }
+    return true;
+}
+
+/* -------------------- Benchmarks -------------------- */
+// Run with: JamesCafe --bench <name> [size]
+
+// Synthetic catalog for scale checks; deterministic for a given seed.
+void buildSyntheticMenu(Menu& menu, size_t count, unsigned seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> price(40.0, 400.0);
+    uniform_int_distribution<int> stock(0, 40);
+    uniform_int_distribution<int> sold(0, 500);
+    uniform_int_distribution<int> attr(0, 127);
+    menu.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        Item it(menu.intern("Item " + to_string(i)), floor(price(rng)), stock(rng) < 4 ? 0 : stock(rng),
+            CATEGORY_NAMES[i % 4]);
+        it.sold = sold(rng);
+        menu.add(it, static_cast<AttrMask>(attr(rng)));
+    }
+}
+
+template <typename Fn>
+double averageMicros(int iterations, Fn fn) {
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) fn();
+    auto elapsed = chrono::steady_clock::now() - start;
+    return chrono::duration<double, micro>(elapsed).count() / iterations;
+}
+
+int benchQuery(size_t count) {
+    Menu menu;
+    buildSyntheticMenu(menu, count, 42);
+    menu.buildIndexes();
+
+    struct Case { const char* label; MenuQuery q; };
+    vector<Case> cases(4);
+    cases[0].label = "Beverages < 150, no dairy, top 20 by popularity";
+    cases[0].q.category = "Beverages";
+    cases[0].q.maxPrice = 150;
+    cases[0].q.diet.mustNot = ATTR_DAIRY;
+    cases[0].q.limit = 20;
+    cases[1].label = "Any category 100-120, vegan, top 20 by popularity";
+    cases[1].q.minPrice = 100;
+    cases[1].q.maxPrice = 120;
+    cases[1].q.diet.mustHave = ATTR_VEGAN;
+    cases[1].q.limit = 20;
+    cases[2].label = "Snacks, gluten-free, top 20 by price";
+    cases[2].q.category = "Snacks";
+    cases[2].q.diet.mustNot = ATTR_GLUTEN;
+    cases[2].q.sort = SortBy::Price;
+    cases[2].q.limit = 20;
+    cases[3].label = "Desserts 200-210, all matches by popularity";
+    cases[3].q.category = "Desserts";
+    cases[3].q.minPrice = 200;
+    cases[3].q.maxPrice = 210;
+
+    vector<Item*> out;
+    cout << "Menu query benchmark, " << count << " items\n";
+    for (auto& c : cases) {
+        size_t hits = 0;
+        double us = averageMicros(1000, [&]() { menu.query(c.q, out); hits = out.size(); });
+        cout << "  " << left << setw(50) << c.label << right << setw(10) << fixed << setprecision(2)
+            << us << " us  (" << hits << " hits)\n";
+    }
+
+    // the linear scan the query replaces, for reference
+    double scan = averageMicros(100, [&]() {
+        out.clear();
+        for (auto& it : menu) {
+            if (it.category == "Beverages" && it.price <= 150 && it.qty > 0
+                && (menu.attrs[menu.indexOf(&it)] & ATTR_DAIRY) == 0) out.push_back(&it);
+        }
+        });
+    cout << "  " << left << setw(50) << "Full scan + filter (reference)" << right << setw(10) << scan << " us\n";
+
+    // a freshly loaded menu: every item shares sold = 0 until its first sale
+    for (auto& it : menu) it.sold = 0;
+    menu.buildIndexes();
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < menu.size(); ++i) menu.adjustStock(i, 0, 1);
+    double firstSale = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / max<size_t>(count, 1);
+    cout << "  " << left << setw(50) << "First sale of every item, fresh menu" << right << setw(10) << firstSale
+        << " us/sale\n";
+    return 0;
+}
+
+double percentile(vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = static_cast<size_t>(p * (v.size() - 1));
+    nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+// Simulated ordering sessions: each step browses and adds a line, then
+// checkout fans out into receipt rendering and journaling tasks. One in a
+// hundred sessions is a bulk order with hundreds of steps.
+struct SimSession {
+    Order order;
+    int stepsLeft = 0;
+    bool heavy = false;
+    mt19937 rng;
+    vector<Item*> found;
+    unique_ptr<SessionOutput> out;
+    chrono::steady_clock::time_point start;
+    double latencyMs = 0.0;
+};
+
+int openNullDevice() {
+#ifdef _WIN32
+    return _open("NUL", _O_WRONLY);
+#else
+    return open("/dev/null", O_WRONLY);
+#endif
+}
+
+// Sessions render their screens and receipts through their own
+// SessionOutput into the null device, so the figures include output.
+int benchSessions(size_t count) {
+    const int sink = openNullDevice();
+    if (sink < 0) {
+        cerr << "Cannot open the null device\n";
+        return 1;
+    }
+    Menu menu;
+    buildSyntheticMenu(menu, 2000, 7);
+    for (auto& it : menu) it.qty = 1000000000;
+    menu.buildIndexes();
+
+    const unsigned threads = max(2u, thread::hardware_concurrency());
+    cout << "Session scheduler benchmark, " << count << " sessions, " << threads << " workers\n";
+
+    for (int stealing = 0; stealing <= 1; ++stealing) {
+        vector<SimSession> sessions(count);
+        mutex journalMutex;
+        string journal;
+        WorkStealingPool pool(threads, stealing != 0);
+        function<void(SimSession*)> step;
+
+        step = [&](SimSession* s) {
+            SessionBinding bind(*s->out);
+            if (s->stepsLeft-- > 0) {
+                MenuQuery q;
+                q.category = CATEGORY_NAMES[s->rng() % 4];
+                q.maxPrice = 100.0 + s->rng() % 300;
+                q.limit = 10;
+                {
+                    lock_guard<mutex> lk(menu.guard);
+                    menu.query(q, s->found);
+                    if (!s->found.empty()) {
+                        Item* it = s->found[s->rng() % s->found.size()];
+                        menu.adjustStock(menu.indexOf(it), -1, 1);
+                        s->order.lines.push_back(OrderLine{ it, 1 });
+                    }
+                    printAvailable(s->found); // stock counts are read under the menu lock
+                }
+                flushScreen();
+                pool.submit([&step, s]() { step(s); });
+                return;
+            }
+            pool.submit([&, s]() {
+                SessionBinding bind(*s->out);
+                emitReceipt(s->order);
+                pool.submit([&, s]() {
+                    {
+                        lock_guard<mutex> lk(journalMutex);
+                        journal += to_string(s->order.receiptNo) + "\t" + to_string(s->order.total()) + "\n";
+                    }
+                    s->latencyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - s->start).count();
+                    });
+                });
+        };
+
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            SimSession* s = &sessions[i];
+            s->rng.seed(static_cast<unsigned>(i));
+            s->heavy = i % 100 == 0;
+            s->stepsLeft = s->heavy ? 400 : 1 + static_cast<int>(s->rng() % 5);
+            s->order.receiptNo = i + 1;
+            s->out.reset(new SessionOutput(sink, sink));
+            s->start = chrono::steady_clock::now();
+            pool.submit([&step, s]() { step(s); });
+        }
+        pool.wait();
+        double wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        vector<double> normal, heavy;
+        for (auto& s : sessions) (s.heavy ? heavy : normal).push_back(s.latencyMs);
+        cout << "  " << (stealing ? "work stealing " : "pinned workers") << fixed << setprecision(2)
+            << "  wall " << setw(8) << wallMs << " ms"
+            << "  p50 " << setw(7) << percentile(normal, 0.50) << " ms"
+            << "  p99 " << setw(7) << percentile(normal, 0.99) << " ms"
+            << "  bulk p50 " << setw(7) << percentile(heavy, 0.50) << " ms\n";
+    }
+#ifdef _WIN32
+    _close(sink);
+#else
+    close(sink);
+#endif
+    return 0;
+}
+
+// Allocation budget per committed order on the scripted transaction below;
+// --bench alloc fails when a change pushes the steady state above it.
+const double ALLOC_BUDGET_PER_ORDER = 2.0;
+
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+// Drives the real ordering flow from a script with output discarded, then
+// reports steady-state allocations per phase after a warm-up.
+int benchAlloc(size_t orders) {
+    static const char* const NAMES[] = { "Ana", "Bartholomew Santos", "Carla", "Daniel de la Cruz" };
+    Menu menu;
+    loadDefaultMenu(menu);
+    for (auto& it : menu) it.qty = 100000000;
+    menu.buildIndexes();
+    CafeDay day(menu);
+
+    auto script = [&](size_t n) {
+        vector<string> lines;
+        for (size_t i = 0; i < n; ++i) {
+            lines.push_back(NAMES[i % 4]);
+            lines.push_back(i % 2 ? "y" : "n");
+            lines.push_back(to_string(1 + i % 4));      // category
+            lines.push_back("1");                       // item
+            lines.push_back(to_string(1 + i % 3));      // quantity
+            lines.push_back(i % 3 ? "n" : "y");         // add more?
+            if (i % 3 == 0) {
+                lines.push_back("5");                   // search
+                lines.push_back("latte");
+                lines.push_back("1");
+                lines.push_back("1");
+                lines.push_back("n");
+            }
+            lines.push_back("n");                       // continue ordering?
+        }
+        return lines;
+    };
+
+    NullBuffer null;
+    streambuf* saved = cout.rdbuf(&null);
+    auto run = [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            Order order;
+            day.allocReport.beginOrder();
+            if (!takeOrder(menu, order)) break;
+            day.checkout(order);
+        }
+    };
+    sessionTape().loadScript(script(64));
+    run(64); // warm-up: thread-local buffers and container capacity
+    sessionTape().loadScript(script(orders));
+    for (auto& c : AllocStats::counters) { c.calls = 0; c.bytes = 0; }
+    day.allocReport = AllocReport();
+    AllocStats::enabled = true;
+    auto start = chrono::steady_clock::now();
+    run(orders);
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    AllocStats::enabled = false;
+    cout.rdbuf(saved);
+
+    cout << "Allocation benchmark, " << orders << " scripted orders (" << fixed << setprecision(2)
+        << us / max<size_t>(orders, 1) << " us/order)";
+    day.allocReport.print(cout);
+    if (day.allocReport.callsPerOrder() > ALLOC_BUDGET_PER_ORDER) {
+        cout << "FAIL: " << day.allocReport.callsPerOrder() << " allocations per order exceeds budget of "
+            << ALLOC_BUDGET_PER_ORDER << "\n";
+        return 4;
+    }
+    cout << "OK: within budget of " << ALLOC_BUDGET_PER_ORDER << " allocations per order\n";
+    return 0;
+}
+
+// Group-commit throughput: each appender stands for a till with `window`
+// orders in flight and waits for the last one to be durable.
+int benchJournal(size_t records) {
+    const string path = "bench-journal.tmp";
+    Menu menu;
+    loadDefaultMenu(menu);
+    Order order;
+    order.customerName = "Bartholomew Santos";
+    order.dineOption = "Take-Out";
+    order.receiptNo = 123456789;
+    order.lines.push_back(OrderLine{ &menu.items[0], 2 });
+    order.lines.push_back(OrderLine{ &menu.items[4], 1 });
+    string record;
+    appendJournalRecord(record, order);
+
+    const unsigned threads = 8;
+    const size_t window = 64;
+    cout << "Journal group-commit benchmark, " << records << " records of " << record.size() << " bytes, "
+        << threads << " appenders x " << window << " in flight\n";
+    for (int allowUring = 1; allowUring >= 0; --allowUring) {
+        JournalWriter w;
+        if (!w.open(path, true, allowUring != 0)) {
+            cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+        if (allowUring && strcmp(w.backend(), "io_uring") != 0) {
+            cout << "  io_uring         unavailable on this system\n";
+            continue;
+        }
+        const char* name = w.backend();
+        auto start = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t]() {
+                for (size_t i = t * window; i < records; i += threads * window) {
+                    unsigned long long last = 0;
+                    for (size_t k = i; k < min(records, i + window); ++k) last = w.append(record.data(), record.size());
+                    w.waitDurable(last);
+                }
+                });
+        }
+        for (auto& th : pool) th.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        w.close();
+        cout << "  " << left << setw(17) << name << right << fixed << setprecision(0) << setw(10)
+            << records / max(secs, 1e-9) << " durable records/s  " << setw(7) << w.syncCount() << " syncs  "
+            << setprecision(1) << setw(7) << static_cast<double>(records) / max<unsigned long long>(w.syncCount(), 1)
+            << " records/sync" << (w.ok() ? "" : "  (write failed)") << "\n";
+    }
+    remove(path.c_str());
+
+    // The checkout path: each register appends whole orders through
+    // OrderJournal, one in flight, while segments fill and are sealed.
+    const size_t orders = max<size_t>(records / 50, 1);
+    {
+        OrderJournal journal;
+        if (!journal.open(path, menu, 128 * 1024)) {
+            cerr << "Cannot write " << segmentPath(path, 1) << "\n";
+            return 1;
+        }
+        atomic<size_t> next(0), failed(0);
+        auto start = chrono::steady_clock::now();
+        vector<thread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&]() {
+                while (next.fetch_add(1) < orders) {
+                    if (!journal.append(order)) failed.fetch_add(1);
+                }
+                });
+        }
+        for (auto& th : pool) th.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  " << left << setw(17) << "OrderJournal" << right << fixed << setprecision(0) << setw(10)
+            << orders / max(secs, 1e-9) << " durable orders/s   " << setw(7) << journal.syncCount() << " syncs  "
+            << setprecision(1) << setw(7) << static_cast<double>(orders) / max<unsigned long long>(journal.syncCount(), 1)
+            << " orders/sync, " << threads << " registers, " << journal.activeSegment() - 1 << " segments sealed"
+            << (failed.load() ? "  (write failed)" : "") << "\n";
+    }
+    for (unsigned n = 1; fileExists(segmentPath(path, n)); ++n) remove(segmentPath(path, n).c_str());
+    return 0;
+}
+
+// Journal block codec on generated orders: size per order, encode speed,
+// and full scans (decode + parse) against scanning the text. A scan off
+// disk costs read time plus CPU time, so the last column assumes a
+// 200 MB/s disk to show where compression pays off.
+int benchCompress(size_t orders) {
+    GeneratorOptions opt;
+    opt.orders = orders;
+    GeneratorModel model;
+    string menuText, text;
+    generateMenu(opt, model, menuText);
+    buildOrderModel(opt, model);
+    generateOrders(opt, model, 0, 0, orders, text);
+    const double diskBytesPerSec = 200e6;
+
+    long long units = 0;
+    auto count = [&](const vector<string_view>& f) {
+        for (size_t k = 4; k + 1 < f.size(); k += 2) units += parseQuantity(f[k]);
+    };
+    auto secondsFor = [](auto fn) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    double textScan = secondsFor([&]() { forEachJournalRecord(text.data(), text.data() + text.size(), count); });
+    const long long expectUnits = units;
+
+    cout << "Journal compression, " << orders << " orders, " << fixed << setprecision(1)
+        << text.size() / 1048576.0 << " MiB of text\n"
+        << "  mode   bytes/order  ratio   encode MB/s   scan MB/s   scan @200MB/s disk\n";
+    auto row = [&](const char* name, size_t bytes, double encode, double scan) {
+        cout << "  " << left << setw(6) << name << right << setw(12) << setprecision(1)
+            << static_cast<double>(bytes) / max<size_t>(orders, 1) << setw(7)
+            << static_cast<double>(text.size()) / max<size_t>(bytes, 1) << "x" << setw(13) << setprecision(0)
+            << (encode > 0 ? text.size() / 1e6 / encode : 0.0) << setw(12) << text.size() / 1e6 / max(scan, 1e-9)
+            << setw(18) << setprecision(1) << (bytes / diskBytesPerSec + scan) * 1000.0 << " ms\n";
+    };
+    row("text", text.size(), 0.0, textScan);
+    for (JournalCompression mode : { JournalCompression::Dictionary, JournalCompression::DictionaryLz }) {
+        string blocks;
+        double encode = secondsFor([&]() { encodeJournalBlocks(text.data(), text.data() + text.size(), mode, blocks); });
+        units = 0;
+        bool ok = true;
+        double scan = secondsFor([&]() { ok = forEachStoredRecord(blocks.data(), blocks.data() + blocks.size(), count); });
+        // every record must decode back to the original bytes
+        string decoded;
+        ok = ok && forEachStoredRecord(blocks.data(), blocks.data() + blocks.size(), [&](const vector<string_view>& f) {
+            for (size_t k = 0; k < f.size(); ++k) {
+                if (k) decoded += '\t';
+                decoded.append(f[k].data(), f[k].size());
+            }
+            decoded += '\n';
+            });
+        if (!ok || units != expectUnits || decoded != text) {
+            cerr << "Round trip failed for " << compressionName(mode) << "\n";
+            return 1;
+        }
+        row(compressionName(mode), blocks.size(), encode, scan);
+    }
+    return 0;
+}
+
+// Cost of a logEvent() call with the formatter running into the null
+// device, for 1 and 4 producer threads. Bursts fit in the ring and are
+// timed alone, as at a till where events come a few per order; the flood
+// runs never pause, so the formatter falls behind and events are dropped.
+// The producers never wait either way.
+int benchLog(size_t events) {
+    const char* sink =
+#ifdef _WIN32
+        "NUL";
+#else
+        "/dev/null";
+#endif
+    const size_t burst = EventLog::CAPACITY / 2;
+    cout << "Event log, " << events << " events per run\n";
+    for (bool flood : { false, true }) {
+        for (unsigned threads : { 1u, 4u }) {
+            if (!eventLog().open(sink)) {
+                cerr << "Cannot open " << sink << "\n";
+                return 1;
+            }
+            double busy = 0.0;
+            for (size_t done = 0; done < events; done += flood ? events : burst) {
+                const size_t n = flood ? events : min(burst, events - done);
+                auto start = chrono::steady_clock::now();
+                vector<thread> producers;
+                for (unsigned t = 0; t < threads; ++t) {
+                    producers.emplace_back([&, t]() {
+                        for (size_t i = t; i < n; i += threads) {
+                            logEvent(Event::ItemAdded, "Cappuccino", 1, static_cast<int32_t>(i & 1023));
+                        }
+                        });
+                }
+                for (auto& p : producers) p.join();
+                busy += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                while (!flood && eventLog().writtenCount() + eventLog().droppedCount() < done + n) {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                }
+            }
+            eventLog().close();
+            cout << "  " << (flood ? "flood" : "burst") << ", " << threads << " producer" << (threads > 1 ? "s" : " ")
+                << fixed << setprecision(1) << setw(9) << busy * 1e9 / max<size_t>(events, 1) << " ns/event  "
+                << setw(10) << eventLog().writtenCount() << " written  " << setw(10) << eventLog().droppedCount()
+                << " dropped\n";
+        }
+    }
+    return 0;
+}
+
+// The JSON side of the wire benchmark: reads back what appendReceiptJson
+// writes, the way a receiver without the binary protocol would.
+struct JsonReceipt {
+    unsigned long long receiptNo = 0, epochMs = 0;
+    string customer, dine;
+    vector<pair<long, int>> lines; // menu index, quantity
+    double total = 0.0;
+    int etaMinutes = -1;
+};
+
+bool parseJsonString(const char*& p, const char* end, string& out) {
+    out.clear();
+    if (p >= end || *p != '"') return false;
+    for (++p; p < end && *p != '"'; ++p) {
+        if (*p != '\\') { out += *p; continue; }
+        if (++p >= end) return false;
+        switch (*p) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case 'u':
+            if (end - p < 5) return false;
+            out += static_cast<char>(strtol(string(p + 1, 4).c_str(), nullptr, 16));
+            p += 4;
+            break;
+        default: out += *p;
+        }
+    }
+    if (p >= end) return false;
+    ++p;
+    return true;
+}
+
+bool parseReceiptJson(const char* p, const char* end, Menu& menu, JsonReceipt& r) {
+    string key, text;
+    auto expect = [&](char c) { if (p < end && *p == c) { ++p; return true; } return false; };
+    auto number = [&](double& v) {
+        char* stop = nullptr;
+        v = strtod(p, &stop);
+        if (stop == p) return false;
+        p = stop;
+        return true;
+    };
+    r.lines.clear();
+    r.etaMinutes = -1;
+    if (!expect('{')) return false;
+    do {
+        double v = 0.0;
+        if (!parseJsonString(p, end, key) || !expect(':')) return false;
+        if (key == "type") { if (!parseJsonString(p, end, text)) return false; }
+        else if (key == "customer") { if (!parseJsonString(p, end, r.customer)) return false; }
+        else if (key == "dine") { if (!parseJsonString(p, end, r.dine)) return false; }
+        else if (key == "lines") {
+            if (!expect('[')) return false;
+            if (expect(']')) continue;
+            do {
+                long item = -1;
+                double qty = 0.0;
+                if (!expect('{')) return false;
+                do {
+                    if (!parseJsonString(p, end, key) || !expect(':')) return false;
+                    if (key == "item") {
+                        if (!parseJsonString(p, end, text)) return false;
+                        item = menu.find(text);
+                    }
+                    else if (!number(key == "qty" ? qty : v)) return false;
+                } while (expect(','));
+                if (!expect('}')) return false;
+                r.lines.emplace_back(item, static_cast<int>(qty));
+            } while (expect(','));
+            if (!expect(']')) return false;
+        }
+        else {
+            if (!number(v)) return false;
+            if (key == "receipt") r.receiptNo = static_cast<unsigned long long>(v);
+            else if (key == "epoch_ms") r.epochMs = static_cast<unsigned long long>(v);
+            else if (key == "total") r.total = v;
+            else if (key == "eta_minutes") r.etaMinutes = static_cast<int>(v);
+        }
+    } while (expect(','));
+    return expect('}');
+}
+
+// Receipts for a 1,000-item menu, encoded and then read back field by
+// field as binary frames and as JSON lines. The binary reader resolves
+// items by index; the JSON one has to look names up.
+int benchWire(size_t receipts) {
+    Menu menu;
+    buildSyntheticMenu(menu, 1000, 7);
+    menu.buildIndexes();
+    mt19937 rng(11);
+    uniform_int_distribution<int> lineCount(1, 6), pick(0, 999), qty(1, 4), eta(-1, 30);
+    vector<Order> orders(receipts);
+    for (size_t i = 0; i < receipts; ++i) {
+        Order& o = orders[i];
+        o.customerName = "Customer " + to_string(i % 5000);
+        o.dineOption = i % 3 ? "Take-Out" : "Eat-In";
+        o.receiptNo = 1000 + i;
+        o.etaMinutes = eta(rng);
+        for (int k = lineCount(rng); k > 0; --k) o.lines.push_back({ &menu.items[pick(rng)], qty(rng) });
+    }
+
+    // the other message types, once each through encode and read-back
+    string other;
+    encodeMenuSnapshot(menu, 1, other);
+    encodeOrderSubmit(orders[0], menu, 1, 77, other);
+    encodeStockDelta(1, { { 3, -2, 2, 0 } }, other);
+    WireFrame f;
+    long long used = wireNextFrame(other.data(), other.size(), f);
+    MenuSnapshotView snapshot(f);
+    bool roundTrip = used > 0 && snapshot.check() && snapshot.size() == menu.size()
+        && snapshot.text(snapshot[999].name) == menu.items[999].name && snapshot[999].qty == menu.items[999].qty;
+    size_t at = static_cast<size_t>(max(used, 0LL));
+    used = wireNextFrame(other.data() + at, other.size() - at, f);
+    OrderSubmitView submit(f);
+    roundTrip = roundTrip && used > 0 && submit.check() && submit.header().clientRef == 77
+        && submit.size() == orders[0].lines.size() && submit[0].item == menu.indexOf(orders[0].lines[0].item);
+    at += static_cast<size_t>(max(used, 0LL));
+    used = wireNextFrame(other.data() + at, other.size() - at, f);
+    const int before = menu.items[3].qty;
+    roundTrip = roundTrip && used > 0 && at + used == other.size() && f.type == WireType::StockDelta
+        && !ReceiptView(f).check() && StockDeltaView(f).check() && applyStockDelta(menu, 1, StockDeltaView(f))
+        && menu.items[3].qty == before - 2;
+    // a frame of a type this build does not know stops the stream
+    string unknown = other.substr(at);
+    unknown[4] = 9;
+    roundTrip = roundTrip && wireNextFrame(unknown.data(), unknown.size(), f) == -1;
+    if (!roundTrip) {
+        cerr << "Wire round trip failed\n";
+        return 1;
+    }
+
+    auto secondsFor = [](auto fn) {
+        auto start = chrono::steady_clock::now();
+        fn();
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    string binary, json;
+    binary.reserve(receipts * 128);
+    json.reserve(receipts * 256);
+    double binEncode = secondsFor([&]() { for (const Order& o : orders) encodeReceipt(o, menu, 1, binary); });
+    double jsonEncode = secondsFor([&]() { for (const Order& o : orders) appendReceiptJson(json, o); });
+
+    // Both readers fold every field into the same check values.
+    long long binUnits = 0, jsonUnits = 0;
+    double binTotal = 0.0, jsonTotal = 0.0;
+    size_t binCount = 0, jsonCount = 0;
+    bool ok = true;
+    double binDecode = secondsFor([&]() {
+        WireFrame f;
+        for (size_t at = 0; at < binary.size();) {
+            long long used = wireNextFrame(binary.data() + at, binary.size() - at, f);
+            ReceiptView v(f);
+            if (used <= 0 || f.type != WireType::Receipt || !v.check()) { ok = false; break; }
+            const WireReceiptHeader h = v.header();
+            binTotal += h.total + h.etaMinutes + v.text(h.customer).size() + h.eatIn;
+            for (uint32_t k = 0; k < h.count; ++k) {
+                const WireReceiptLine l = v[k];
+                binUnits += l.qty * static_cast<long long>(l.item + 1);
+            }
+            ++binCount;
+            at += static_cast<size_t>(used);
+        }
+        });
+    double jsonDecode = secondsFor([&]() {
+        JsonReceipt r;
+        const char* p = json.data();
+        const char* end = p + json.size();
+        while (p < end) {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+            if (!eol || !parseReceiptJson(p, eol, menu, r)) { ok = false; break; }
+            jsonTotal += r.total + r.etaMinutes + r.customer.size() + (r.dine == "Eat-In");
+            for (auto& l : r.lines) jsonUnits += l.second * static_cast<long long>(l.first + 1);
+            ++jsonCount;
+            p = eol + 1;
+        }
+        });
+    if (!ok || binCount != receipts || jsonCount != receipts || binUnits != jsonUnits
+        || fabs(binTotal - jsonTotal) > 0.01 * receipts) {
+        cerr << "Wire and JSON receipts disagree\n";
+        return 1;
+    }
+
+    cout << "Receipt codecs, " << receipts << " receipts\n"
+        << "  codec   bytes/msg   encode ns/msg   decode ns/msg   decode MB/s\n";
+    auto row = [&](const char* name, size_t bytes, double encode, double decode) {
+        cout << "  " << left << setw(6) << name << right << fixed << setprecision(1) << setw(11)
+            << static_cast<double>(bytes) / max<size_t>(receipts, 1) << setw(16) << encode * 1e9 / max<size_t>(receipts, 1)
+            << setw(16) << decode * 1e9 / max<size_t>(receipts, 1) << setw(14) << setprecision(0)
+            << bytes / 1e6 / max(decode, 1e-9) << "\n";
+    };
+    row("wire", binary.size(), binEncode, binDecode);
+    row("json", json.size(), jsonEncode, jsonDecode);
+    return 0;
+}
+
+// Write throughput and point-query latency for each order store, on
+// orders from a 1,000-item menu. Writes are saved one order at a time as
+// checkout does and committed at the end; the journal syncs every order,
+// SQLite once per batch. Queries are timed for up to half a second each,
+// since the journal answers by scanning.
+int benchStore(size_t orders) {
+    const string dir = "bench-store";
+    Menu menu;
+    buildSyntheticMenu(menu, 1000, 5);
+    menu.buildIndexes();
+    mt19937 rng(17);
+    uniform_int_distribution<int> lineCount(1, 5), pick(0, 999), qty(1, 3);
+    vector<Order> day(orders);
+    for (size_t i = 0; i < orders; ++i) {
+        day[i].customerName = "Customer " + to_string(i % 2000);
+        day[i].dineOption = i % 3 ? "Take-Out" : "Eat-In";
+        day[i].receiptNo = 500000 + i;
+        for (int k = lineCount(rng); k > 0; --k) day[i].lines.push_back({ &menu.items[pick(rng)], qty(rng) });
+    }
+
+    auto cleanup = [&]() {
+        remove((dir + "-journal.txt").c_str());
+        for (unsigned n = 1; fileExists(segmentPath(dir + "-journal.txt", n)); ++n) {
+            remove(segmentPath(dir + "-journal.txt", n).c_str());
+        }
+        for (const char* suffix : { ".db", ".db-wal", ".db-shm" }) remove((dir + suffix).c_str());
+    };
+    cleanup();
+
+    cout << "Order stores, " << orders << " orders\n"
+        << "  store       orders/s   find order   customer   units sold   stock level\n";
+    auto run = [&](OrderStore& store) {
+        auto start = chrono::steady_clock::now();
+        for (const Order& o : day) store.saveOrder(o);
+        store.commit();
+        double writeSecs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!store.ok()) {
+            cerr << store.name() << ": write failed\n";
+            return false;
+        }
+
+        // microseconds per query, cycling through keys
+        auto timeQuery = [&](auto query) {
+            auto begin = chrono::steady_clock::now();
+            double secs = 0.0;
+            size_t n = 0;
+            while (n < 2000 && secs < 0.5) {
+                query(n++);
+                secs = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            }
+            return secs * 1e6 / max<size_t>(n, 1);
+        };
+        StoredOrder found;
+        bool correct = true;
+        double find = timeQuery([&](size_t n) {
+            const Order& o = day[(n * 7919) % orders];
+            correct = correct && store.findOrder(o.receiptNo, found) && found.lines.size() == o.lines.size();
+            });
+        double customer = timeQuery([&](size_t n) { correct = correct && store.customer(day[n % orders].customerName).orders > 0; });
+        double sold = timeQuery([&](size_t n) { correct = correct && store.unitsSold(menu.items[n % 1000].name) >= 0; });
+        int level = 0;
+        double stock = timeQuery([&](size_t n) {
+            const Item& it = *day[n % orders].lines[0].item;
+            correct = correct && store.stockLevel(it.name, level) && level == it.qty;
+            });
+        if (!correct) {
+            cerr << store.name() << ": query returned the wrong answer\n";
+            return false;
+        }
+        cout << "  " << left << setw(8) << store.name() << right << fixed << setprecision(0) << setw(12)
+            << orders / max(writeSecs, 1e-9) << setprecision(1) << setw(11) << find << " us" << setw(8) << customer
+            << " us" << setw(10) << sold << " us" << setw(11) << stock << " us\n";
+        return true;
+    };
+
+    bool ok = true;
+    {
+        MemoryStore store;
+        ok = run(store);
+    }
+    {
+        OrderJournal journal;
+        ok = ok && journal.open(dir + "-journal.txt", menu, SEGMENT_BYTES, JournalCompression::DictionaryLz);
+        JournalStore store(journal, menu);
+        ok = ok && run(store);
+    }
+#if JC_SQLITE
+    {
+        SqliteStore store;
+        string error;
+        if (!store.open(dir + ".db", menu, error)) {
+            cerr << "Cannot open " << dir << ".db: " << error << "\n";
+            ok = false;
+        }
+        ok = ok && run(store);
+    }
+#else
+    cout << "  sqlite      not built (compile with -DJC_SQLITE=1 and link sqlite3)\n";
+#endif
+    cleanup();
+    return ok ? 0 : 1;
+}
+
+// HQ publishes a catalog, then a day's edits to it (price changes, new
+// and withdrawn items); a branch holding the first version pulls the
+// second. Reports what the pull reads and how long applying it takes.
+int benchMenuSync(size_t items) {
+    const string dir = "bench-menusync";
+    const string menuPath = dir + "-menu.txt";
+    auto writeMenu = [&](const Menu& menu) {
+        string text;
+        for (size_t i = 0; i < menu.size(); ++i) appendMenuRecord(text, menu.items[i], menu.attrs[i]);
+        return writeFileAtomic(menuPath, text);
+    };
+    auto cleanup = [&]() {
+        remove(menuPath.c_str());
+        for (unsigned long long v = 1; v <= 3; ++v) remove(menuSyncPath(dir, v).c_str());
+        remove((dir + "/menu.snapshot").c_str());
+        remove((dir + "/menu.version").c_str());
+        removeDirectory(dir);
+    };
+
+    Menu hq;
+    buildSyntheticMenu(hq, items, 3);
+    MenuDelta published;
+    string error;
+    bool ok = writeMenu(hq) && publishMenu(menuPath, dir, published, error);
+
+    Menu branch;
+    MenuSync sync(dir);
+    MenuDelta delta;
+    auto start = chrono::steady_clock::now();
+    ok = ok && sync.fetch(delta, error);
+    const size_t initial = ok ? sync.apply(branch, delta) : 0;
+    const double initialMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    const size_t initialBytes = sync.bytesRead();
+
+    // A day at HQ: 200 repriced, 50 added, 20 withdrawn. The edited menu is
+    // built anew, as HQ's menu file would be.
+    mt19937 rng(9);
+    uniform_int_distribution<size_t> pick(0, items - 1);
+    for (int i = 0; i < 200; ++i) hq.items[pick(rng)].price += 5.0;
+    Menu edited;
+    edited.reserve(items + 50);
+    for (size_t i = 0; i < hq.size(); ++i) {
+        if (i % (items / 20) != 7) edited.add(hq.items[i], hq.attrs[i]);
+    }
+    for (int i = 0; i < 50; ++i) edited.add(Item(edited.intern("Seasonal " + to_string(i)), 180.0, 20, CATEGORY_NAMES[i % 4]));
+
+    // Pulls what HQ lists now; fills in the timings of the delta.
+    auto pull = [&](double& fetchMs, double& applyMs, size_t& bytes) {
+        ok = ok && writeMenu(edited) && publishMenu(menuPath, dir, published, error);
+        const size_t before = sync.bytesRead();
+        auto t0 = chrono::steady_clock::now();
+        ok = ok && sync.fetch(delta, error);
+        fetchMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        t0 = chrono::steady_clock::now();
+        const size_t changed = ok ? sync.apply(branch, delta) : 0;
+        applyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        bytes = sync.bytesRead() - before;
+        for (size_t i = 0; ok && i < edited.size(); ++i) {
+            const long idx = branch.find(edited.items[i].name);
+            ok = idx >= 0 && priceCents(branch.items[static_cast<size_t>(idx)].price) == priceCents(edited.items[i].price);
+        }
+        return changed;
+    };
+    double fetchMs = 0.0, applyMs = 0.0, repriceFetchMs = 0.0, repriceApplyMs = 0.0;
+    size_t bytes = 0, repriceBytes = 0;
+    const size_t changed = pull(fetchMs, applyMs, bytes);
+    // The next day only prices move, so the delta lands in place.
+    for (int i = 0; i < 200; ++i) edited.items[pick(rng)].price += 5.0;
+    const size_t repriced = pull(repriceFetchMs, repriceApplyMs, repriceBytes);
+    cleanup();
+    if (!ok) {
+        cerr << "Menu sync failed" << (error.empty() ? "" : ": " + error) << "\n";
+        return 1;
+    }
+    cout << "Menu sync, " << items << " items\n" << fixed << setprecision(1)
+        << "  first pull (snapshot)  " << setw(10) << initialBytes / 1024.0 << " KiB  " << setw(8) << initialMs
+        << " ms  " << initial << " items changed\n"
+        << "  next pull (delta)      " << setw(10) << bytes / 1024.0 << " KiB  " << setw(8)
+        << fetchMs + applyMs << " ms  " << changed << " items changed (fetch " << fetchMs << " ms, apply "
+        << applyMs << " ms)\n"
+        << "  reprice only (delta)   " << setw(10) << repriceBytes / 1024.0 << " KiB  " << setw(8)
+        << repriceFetchMs + repriceApplyMs << " ms  " << repriced << " items changed (fetch " << repriceFetchMs
+        << " ms, apply " << repriceApplyMs << " ms)\n";
+    return 0;
+}
+
+// Journal appends, as checkout makes them, with and without the shipper
+// running against a slow sink that refuses every third delivery. The
+// shipper is restarted halfway, then drained; HQ must end up with every
+// journaled order once, in order.
+int benchShip(size_t orders) {
+    const string base = "bench-ship";
+    const string journalPath = base + "-journal.txt", spool = base + "-spool", hq = base + "-hq";
+    auto cleanup = [&]() {
+        for (unsigned n = 1; fileExists(segmentPath(journalPath, n)); ++n) remove(segmentPath(journalPath, n).c_str());
+        char name[64];
+        for (unsigned long long seq = 1; seq < 100000; ++seq) {
+            snprintf(name, sizeof(name), "/chunk.%010llu", seq);
+            const bool spooled = remove((spool + name).c_str()) == 0;
+            snprintf(name, sizeof(name), "/bench.%010llu.chunk", seq);
+            if (remove((hq + name).c_str()) != 0 && !spooled) break;
+        }
+        remove((spool + "/checkpoint").c_str());
+        removeDirectory(spool);
+        removeDirectory(hq);
+    };
+    cleanup();
+
+    struct FlakySink : ChunkSink {
+        FileChunkSink target;
+        int calls = 0;
+        explicit FlakySink(const string& dir) : target(dir) {}
+        bool deliver(const string& chunk, string& error) override {
+            this_thread::sleep_for(chrono::milliseconds(20));
+            if (++calls % 3 == 0) {
+                error = "link down";
+                return false;
+            }
+            return target.deliver(chunk, error);
+        }
+    };
+
+    Menu menu;
+    loadDefaultMenu(menu);
+    mt19937 rng(21);
+    uniform_int_distribution<int> pick(0, static_cast<int>(menu.size()) - 1), qty(1, 3);
+    OrderJournal journal;
+    if (!journal.open(journalPath, menu, 256 * 1024, JournalCompression::DictionaryLz)) {
+        cerr << "Cannot write " << journalPath << "\n";
+        return 1;
+    }
+    auto append = [&](size_t n, vector<double>& micros) {
+        Order o;
+        for (size_t i = 0; i < n; ++i) {
+            o.customerName = "Customer " + to_string(i % 300);
+            o.dineOption = i % 2 ? "Eat-In" : "Take-Out";
+            o.receiptNo = micros.size() + 1;
+            o.lines.assign(1, OrderLine(&menu.items[static_cast<size_t>(pick(rng))], qty(rng)));
+            auto start = chrono::steady_clock::now();
+            journal.append(o);
+            micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        }
+    };
+
+    vector<double> alone, shipping;
+    append(orders / 3, alone);
+    string error;
+    unique_ptr<SalesShipper> shipper = make_unique<SalesShipper>();
+    bool ok = shipper->start(journalPath, spool, "bench", make_unique<FlakySink>(hq), chrono::milliseconds(10), error);
+    append(orders / 3, shipping);
+    shipper.reset(); // stops: a restart, with chunks still in the spool
+    shipper = make_unique<SalesShipper>();
+    ok = ok && shipper->start(journalPath, spool, "bench", make_unique<FlakySink>(hq), chrono::milliseconds(10), error);
+    append(orders - orders / 3 * 2, shipping);
+    shipper->stop();
+    const unsigned long long waiting = shipper->waitingCount();
+    shipper = make_unique<SalesShipper>(); // drain what the link refused last
+    ok = ok && shipper->start(journalPath, spool, "bench", make_unique<FileChunkSink>(hq), chrono::milliseconds(10), error);
+    shipper->stop();
+    ok = ok && shipper->waitingCount() == 0;
+
+    // HQ's copy, chunk by chunk, against the journal
+    vector<string> sent, received;
+    forEachJournalOrder(journalPath, [&](const vector<string_view>& f) { sent.emplace_back(f[0]); });
+    size_t chunks = 0, bytes = 0;
+    char name[64];
+    for (unsigned long long seq = 1;; ++seq) {
+        snprintf(name, sizeof(name), "/bench.%010llu.chunk", seq);
+        string chunk;
+        if (!readFileRange(hq + name, 0, static_cast<size_t>(fileSize(hq + name)), chunk)) break;
+        ShipmentHeader h;
+        const char* p;
+        const char* end;
+        ok = ok && readShipment(chunk, h, p, end) && h.seq == seq
+            && forEachStoredRecord(p, end, [&](const vector<string_view>& f) { received.emplace_back(f[0]); });
+        ++chunks;
+        bytes += chunk.size();
+    }
+    cleanup();
+    if (!ok || sent != received) {
+        cerr << "Shipping lost or repeated orders: " << sent.size() << " journaled, " << received.size() << " at HQ"
+            << (error.empty() ? "" : " (" + error + ")") << "\n";
+        return 1;
+    }
+    cout << "Sales shipping, " << orders << " orders, sink 20 ms per chunk and down every third try\n" << fixed
+        << setprecision(1) << "  append p50 / p99 alone          " << setw(8) << percentile(alone, 0.5) << " / "
+        << percentile(alone, 0.99) << " us\n"
+        << "  append p50 / p99 while shipping " << setw(8) << percentile(shipping, 0.5) << " / "
+        << percentile(shipping, 0.99) << " us\n"
+        << "  " << chunks << " chunks, " << setprecision(1) << static_cast<double>(bytes) / max<size_t>(received.size(), 1)
+        << " bytes/order; " << waiting << " chunks were waiting at the last stop; every order at HQ once, in order\n";
+    return 0;
+}
+
+// Seating decisions on a busy floor against a linear best-fit scan over
+// the same arrivals: both must pick the same tables.
+int benchTables(size_t count) {
+    const int sizes[] = { 2, 2, 4, 4, 4, 6, 8 };
+    string spec;
+    const size_t perSize = max<size_t>(count / 7, 1);
+    for (int s : { 2, 4, 6, 8 }) {
+        const size_t n = perSize * static_cast<size_t>(count_if(begin(sizes), end(sizes), [&](int v) { return v == s; }));
+        if (!spec.empty()) spec += ',';
+        spec += to_string(s) + "x" + to_string(n);
+    }
+    TableSeating seating;
+    seating.configure(spec, 30);
+    const size_t tables = seating.size();
+
+    // ~40 minutes at a table, arrivals spaced to keep the floor ~90% full
+    const size_t parties = 1000000;
+    mt19937_64 rng(11);
+    uniform_int_distribution<int> party(1, 8), stay(20, 60);
+    const double gapSeconds = 40.0 * 60.0 / (static_cast<double>(tables) * 0.9);
+    exponential_distribution<double> gap(1.0 / gapSeconds);
+    struct Arrival { TableSeating::Clock::time_point at, leave; int party; };
+    vector<Arrival> arrivals(parties);
+    TableSeating::Clock::time_point now{};
+    for (auto& a : arrivals) {
+        now += chrono::microseconds(static_cast<long long>(gap(rng) * 1e6));
+        a = Arrival{ now, now + chrono::minutes(stay(rng)), party(rng) };
+    }
+
+    vector<uint32_t> indexed(parties), linear(parties);
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < parties; ++i) {
+        seating.releaseDue(arrivals[i].at);
+        indexed[i] = seating.seat(static_cast<uint32_t>(i), arrivals[i].party, arrivals[i].leave);
+    }
+    const double indexedNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / parties;
+
+    vector<TableSeating::Clock::time_point> freeAt(tables);
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < parties; ++i) {
+        uint32_t best = NO_TABLE;
+        for (uint32_t t = 0; t < tables; ++t) {
+            if (freeAt[t] > arrivals[i].at || seating.seats(t) < arrivals[i].party) continue;
+            if (best == NO_TABLE || seating.seats(t) < seating.seats(best)) best = t;
+        }
+        if (best != NO_TABLE) freeAt[best] = arrivals[i].leave;
+        linear[i] = best;
+    }
+    const double linearNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / parties;
+
+    const size_t seated = parties - static_cast<size_t>(std::count(indexed.begin(), indexed.end(), NO_TABLE));
+    if (indexed != linear) {
+        cerr << "Seating disagrees with the linear scan\n";
+        return 1;
+    }
+    cout << "Table seating, " << tables << " tables (" << spec << "), " << parties << " parties\n" << fixed
+        << setprecision(1) << "  indexed      " << setw(8) << indexedNs << " ns/decision\n"
+        << "  linear scan  " << setw(8) << linearNs << " ns/decision\n"
+        << "  " << 100.0 * static_cast<double>(seated) / parties << "% seated on arrival; same tables as the scan\n";
+    return 0;
+}
+
+// Registers editing baskets over shared stock: every add, change, remove
+// and cancel moves only its delta, and afterwards every item's stock plus
+// what sits in baskets must equal what it started with.
+int benchBasket(size_t edits) {
+    Menu menu;
+    buildSyntheticMenu(menu, 200, 5);
+    for (auto& it : menu) it.qty = 6; // scarce, so registers contend and some increases are refused
+    menu.buildIndexes();
+    vector<pair<int, int>> opening;
+    for (const auto& it : menu) opening.emplace_back(it.qty, it.sold);
+
+    const unsigned registers = max(4u, thread::hardware_concurrency());
+    const size_t perRegister = max<size_t>(edits / registers, 1);
+    vector<Order> baskets(registers);
+    vector<size_t> refused(registers, 0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < registers; ++r) {
+        threads.emplace_back([&, r]() {
+            mt19937_64 rng(r + 1);
+            Order& order = baskets[r];
+            for (size_t i = 0; i < perRegister; ++i) {
+                const unsigned op = rng() % 16;
+                if (order.lines.empty() || op < 6) {
+                    refused[r] += !addLine(menu, order, &menu.items[rng() % menu.size()], 1 + static_cast<int>(rng() % 3));
+                }
+                else if (op < 12) {
+                    const size_t line = rng() % order.lines.size();
+                    refused[r] += !setLineQuantity(menu, order, line, static_cast<int>(rng() % 5));
+                }
+                else if (op < 15) mergeDuplicateLines(order);
+                else returnBasket(menu, order);
+            }
+            });
+    }
+    for (auto& t : threads) t.join();
+    const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count()
+        / static_cast<double>(perRegister * registers);
+
+    vector<long long> held(menu.size(), 0);
+    size_t lines = 0;
+    for (const auto& o : baskets) {
+        lines += o.lines.size();
+        for (const auto& l : o.lines) held[menu.indexOf(l.item)] += l.quantity;
+    }
+    for (size_t i = 0; i < menu.size(); ++i) {
+        const Item& it = menu.items[i];
+        if (it.qty < 0 || it.qty + held[i] != opening[i].first || it.sold - opening[i].second != held[i]) {
+            cerr << "Stock drifted for " << it.name << ": " << it.qty << " left, " << held[i] << " in baskets, "
+                << opening[i].first << " at the start\n";
+            return 1;
+        }
+    }
+    size_t refusedTotal = 0;
+    for (size_t n : refused) refusedTotal += n;
+    cout << "Basket editing, " << registers << " registers, " << perRegister * registers << " edits over "
+        << menu.size() << " items\n" << fixed << setprecision(1)
+        << "  " << ns << " ns/edit wall clock; " << refusedTotal << " increases refused for lack of stock\n"
+        << "  " << lines << " lines left in baskets; stock + baskets = opening stock for every item\n";
+    return 0;
+}
+
+int runBenchmark(const string& name, size_t size) {
+    if (name == "query") return benchQuery(size ? size : 100000);
+    if (name == "sessions") return benchSessions(size ? size : 20000);
+    if (name == "alloc") return benchAlloc(size ? size : 10000);
+    if (name == "journal") return benchJournal(size ? size : 500000);
+    if (name == "compress") return benchCompress(size ? size : 300000);
+    if (name == "log") return benchLog(size ? size : 1000000);
+    if (name == "wire") return benchWire(size ? size : 200000);
+    if (name == "store") return benchStore(size ? size : 20000);
+    if (name == "ship") return benchShip(size ? size : 30000);
+    if (name == "menusync") return benchMenuSync(max<size_t>(size ? size : 50000, 100));
+    if (name == "tables") return benchTables(size ? size : 500);
+    if (name == "basket") return benchBasket(size ? size : 1000000);
+    cerr << "Unknown benchmark: " << name << "\n";
+    return 2;
+}
+
+/* -------------------- Main Program -------------------- */
+// Value following `flag` on the command line, or nullptr.
+const char* argValue(int argc, char* argv[], const char* flag) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], flag) == 0) return argv[i + 1];
+    }
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    if (argc >= 3 && string(argv[1]) == "--bench") {
+        size_t size = argc >= 4 ? static_cast<size_t>(strtoull(argv[3], nullptr, 10)) : 0;
+        return runBenchmark(argv[2], size);
+    }
+
+    // --merge-sketches <file>...: chain-wide figures from per-branch/day sketches.
+    if (argc >= 3 && string(argv[1]) == "--merge-sketches") {
+        OrderSketches chain;
+        for (int i = 2; i < argc; ++i) {
+            OrderSketches part;
+            if (!part.load(argv[i])) {
+                cerr << "Cannot read sketch: " << argv[i] << "\n";
+                return 1;
+            }
+            chain.merge(part);
+        }
+        cout << "Merged " << (argc - 2) << " sketches, " << static_cast<long long>(chain.basketSize.count()) << " orders\n";
+        chain.print(cout);
+        return 0;
+    }
+
+    // --publish-menu <menu file> <dir>: HQ publishes the menu file as the
+    // next version in the shared directory branches sync from.
+    if (argc >= 4 && string(argv[1]) == "--publish-menu") {
+        MenuDelta delta;
+        string error;
+        if (!publishMenu(argv[2], argv[3], delta, error)) {
+            cerr << "Cannot publish menu: " << error << "\n";
+            return 1;
+        }
+        if (!delta.version) cout << "Menu unchanged at version " << publishedMenuVersion(argv[3]) << "\n";
+        else cout << "Published menu version " << delta.version << ": " << delta.changes.size() << " changed items\n";
+        return 0;
+    }
+
+    // --receive-sales <port> <dir>: stand-in HQ endpoint for --ship http://...
+    if (argc >= 4 && string(argv[1]) == "--receive-sales") return receiveSales(argv[2], argv[3]);
+
+    // --reconcile <tree> <tree>: which items differ between two closing
+    // inventories (exit code 3 if any do).
+    if (argc >= 4 && string(argv[1]) == "--reconcile") return reconcileTreeFiles(argv[2], argv[3]);
+
+    // --journal-compress off|dict|lz: how sealed journal segments are stored
+    // (default lz). With --generate, anything but off writes the archive as
+    // sealed segments instead of one text file.
+    JournalCompression compression = JournalCompression::DictionaryLz;
+    const char* compressArg = argValue(argc, argv, "--journal-compress");
+    if (compressArg && !parseCompression(compressArg, compression)) {
+        cerr << "Unknown journal compression: " << compressArg << " (off, dict, lz)\n";
+        return 1;
+    }
+
+    // --generate <prefix> [--items N] [--orders N] [--days N] [--seed N] [--start YYYY-MM-DD] [--threads N]
+    // The journal starts on the Monday of --start's week (default 2024-01-01).
+    if (const char* prefix = argValue(argc, argv, "--generate")) {
+        GeneratorOptions opt;
+        if (compressArg) opt.compression = compression;
+        if (const char* v = argValue(argc, argv, "--items")) opt.items = max<size_t>(1, strtoull(v, nullptr, 10));
+        if (const char* v = argValue(argc, argv, "--orders")) opt.orders = strtoull(v, nullptr, 10);
+        if (const char* v = argValue(argc, argv, "--days")) opt.days = max(1, atoi(v));
+        if (const char* v = argValue(argc, argv, "--seed")) opt.seed = strtoull(v, nullptr, 10);
+        if (const char* v = argValue(argc, argv, "--start")) {
+            if (!parseDate(v, opt.startDay)) {
+                cerr << "--start expects a date as YYYY-MM-DD: " << v << "\n";
+                return 1;
+            }
+            opt.startDay -= (opt.startDay + 3) % 7; // 1970-01-01 was a Thursday
+        }
+        if (const char* v = argValue(argc, argv, "--threads")) opt.threads = static_cast<unsigned>(atoi(v));
+        return runGenerator(prefix, opt);
+    }
+
+    // --record <file> | --replay <file> [--speed N]  (N = 0: as fast as possible)
+    double replaySpeed = 1.0;
+    if (const char* v = argValue(argc, argv, "--speed")) replaySpeed = atof(v);
+    if (const char* path = argValue(argc, argv, "--record")) {
+        if (!sessionTape().openRecord(path)) {
+            cerr << "Cannot write capture: " << path << "\n";
+            return 1;
+        }
+    }
+    if (const char* path = argValue(argc, argv, "--replay")) {
+        if (!sessionTape().openReplay(path, replaySpeed)) {
+            cerr << "Cannot read capture: " << path << "\n";
+            return 1;
+        }
+    }
+
+    // --output ansi|plain|json; by default ANSI on a terminal, plain otherwise.
+    OutputFormat format = stdoutIsTerminal() && enableAnsiOnWindows() ? OutputFormat::Ansi : OutputFormat::Plain;
+    if (const char* v = argValue(argc, argv, "--output")) {
+        if (strcmp(v, "ansi") == 0) format = OutputFormat::Ansi;
+        else if (strcmp(v, "plain") == 0) format = OutputFormat::Plain;
+        else if (strcmp(v, "json") == 0) format = OutputFormat::JsonLines;
+        else {
+            cerr << "Unknown output format: " << v << " (ansi, plain, json)\n";
+            return 1;
+        }
+    }
+    output().select(format);
+
+    // --log <file>: business and diagnostic events as JSON lines, appended.
+    if (const char* path = argValue(argc, argv, "--log")) {
+        if (!eventLog().open(path)) {
+            cerr << "Cannot open log: " << path << "\n";
+            return 1;
+        }
+    }
+
+    // --menu <file> replaces the built-in menu; --journal <file> restores
+    // stock from previously committed orders and appends new ones, sealing
+    // a segment every --segment-bytes (default 8 MiB), compressed per
+    // --journal-compress.
+    Menu menu;
+    string error;
+    if (const char* path = argValue(argc, argv, "--menu")) {
+        if (!loadMenuFile(path, menu, error)) {
+            cerr << "Cannot load menu: " << error << "\n";
+            return 1;
+        }
+    }
+    else {
+        loadDefaultMenu(menu);
+    }
+
+    // --plan <journal> [--history-days N] [--plan-out <file>]: forecast
+    // tomorrow from archived sales and suggest opening stock and reorders
+    // against the menu's stock.
+    if (const char* path = argValue(argc, argv, "--plan")) {
+        PlanOptions opt;
+        if (const char* v = argValue(argc, argv, "--history-days")) opt.historyDays = min(max(1, atoi(v)), MAX_HISTORY_DAYS);
+        return runPlan(path, menu, opt, argValue(argc, argv, "--plan-out"));
+    }
+
+    // --menu-sync <dir>: bring the menu up to HQ's published version now,
+    // before the journal is replayed against it, and again between
+    // customers.
+    unique_ptr<MenuSync> menuSync;
+    if (const char* dir = argValue(argc, argv, "--menu-sync")) {
+        menuSync = make_unique<MenuSync>(dir);
+        MenuDelta delta;
+        if (menuSync->fetch(delta, error)) menuSync->apply(menu, delta);
+        if (!error.empty()) cerr << "Menu sync: " << error << "\n";
+        else if (menuSync->version()) screen() << Colors::MUTED << "(Menu at HQ version " << menuSync->version() << ")\n" << Colors::RESET;
+    }
+
+    CafeDay day(menu);
+    if (const char* path = argValue(argc, argv, "--journal")) {
+        long long replayed = replayJournal(path, menu, error, &day.sketches);
+        if (replayed < 0) {
+            cerr << "Cannot replay journal: " << error << "\n";
+            return 1;
+        }
+        size_t segmentBytes = SEGMENT_BYTES;
+        if (const char* v = argValue(argc, argv, "--segment-bytes")) segmentBytes = strtoull(v, nullptr, 10);
+        if (!day.journal.open(path, menu, segmentBytes, compression)) {
+            cerr << "Cannot open journal: " << path << "\n";
+            return 1;
+        }
+        if (replayed > 0) screen() << Colors::MUTED << "(Restored stock from " << replayed << " journaled orders)\n" << Colors::RESET;
+    }
+
+    // --tables 2x8,4x6,... [--dine-minutes N]: seat Eat-In parties; a table
+    // turns over N minutes (default 30) after the order should be ready.
+    if (const char* spec = argValue(argc, argv, "--tables")) {
+        const char* v = argValue(argc, argv, "--dine-minutes");
+        if (!day.tables.configure(spec, v ? atoi(v) : 30)) {
+            cerr << "Bad table layout: " << spec << " (expected seats x count, e.g. 2x8,4x6)\n";
+            return 1;
+        }
+    }
+
+    // --store memory|sqlite:<file>: keep the day's orders somewhere other
+    // than the journal. SQLite restores stock from, and records it to, its
+    // own tables.
+    if (const char* v = argValue(argc, argv, "--store")) {
+        if (day.journal.isOpen()) {
+            cerr << "--store and --journal both choose where orders go; use one\n";
+            return 1;
+        }
+        if (strcmp(v, "memory") == 0) day.store = make_unique<MemoryStore>();
+        else if (strncmp(v, "sqlite:", 7) == 0) {
+#if JC_SQLITE
+            auto sqlite = make_unique<SqliteStore>();
+            if (!sqlite->open(v + 7, menu, error)) {
+                cerr << "Cannot open order database: " << error << "\n";
+                return 1;
+            }
+            day.store = std::move(sqlite);
+#else
+            cerr << "This build has no SQLite support (compile with -DJC_SQLITE=1 and link sqlite3)\n";
+            return 1;
+#endif
+        }
+        else {
+            cerr << "Unknown order store: " << v << " (memory, sqlite:<file>)\n";
+            return 1;
+        }
+    }
+
+    // --ship file:<dir>|http://host[:port]/path [--branch NAME] [--ship-interval MS]:
+    // send the journal's orders to HQ in the background, spooling chunks in
+    // <journal>.ship until they are accepted.
+    SalesShipper shipper;
+    if (const char* target = argValue(argc, argv, "--ship")) {
+        const char* branch = argValue(argc, argv, "--branch");
+        if (!branch) branch = "branch";
+        string host, port, path;
+        unique_ptr<ChunkSink> sink;
+        if (strncmp(target, "file:", 5) == 0) sink = make_unique<FileChunkSink>(target + 5);
+        else if (HttpChunkSink::parse(target, host, port, path)) sink = make_unique<HttpChunkSink>(host, port, path);
+        if (!day.journal.isOpen() || !sink || !validBranchName(branch)) {
+            cerr << "--ship needs --journal, a file:<dir> or http:// target and a branch name of letters, digits, - and _\n";
+            return 1;
+        }
+        const char* every = argValue(argc, argv, "--ship-interval");
+        if (!shipper.start(day.journal.path(), day.journal.path() + ".ship", branch, std::move(sink),
+            chrono::milliseconds(every ? max(10, atoi(every)) : 1000), error)) {
+            cerr << "Cannot start shipping: " << error << "\n";
+            return 1;
+        }
+    }
+
+    // --alloc-stats [--alloc-budget N]: per-phase allocation accounting; with a
+    // budget, exit non-zero when orders average more than N allocations.
+    const char* allocBudget = argValue(argc, argv, "--alloc-budget");
+    bool allocStats = allocBudget != nullptr;
+    for (int i = 1; i < argc; ++i) allocStats = allocStats || strcmp(argv[i], "--alloc-stats") == 0;
+    AllocStats::enabled = allocStats;
+
+    printBackstory();
+
+    while (true) {
+        if (menuSync) {
+            long long changed = day.syncMenu(*menuSync, error);
+            if (changed < 0) cerr << "Menu sync: " << error << "\n";
+            else if (changed > 0) {
+                screen() << Colors::MUTED << "(Menu updated to HQ version " << menuSync->version() << ", " << changed
+                    << (changed == 1 ? " item changed)\n" : " items changed)\n") << Colors::RESET;
+            }
+        }
+        screen() << Colors::ACCENT << "---- New Customer ----" << Colors::RESET << "\n";
+
+        Order order;
+        order.receiptNo = generateReceiptNumber();
+        sessionTape().orderStarted();
+        day.allocReport.beginOrder();
+
+        if (!takeOrder(menu, order, day.tables.largest())) break;
+
+        if (order.lines.empty()) {
+            screen() << Colors::MUTED << "No items ordered. Cancelling this transaction.\n" << Colors::RESET;
+            logEvent(Event::OrderVoided, {}, 0, 0, 0, 0.0, order.customerName);
+        }
+        else {
+            day.checkout(order);
+        }
+        day.settle();
+
+        bool next = false;
+        AllocPhaseScope counterPhase(AllocPhase::Counter);
+        while (true) {
+            showCounterMenu(day.tracker, day.tables);
+            const int lastAction = day.tables.size() ? 8 : 7;
+            int action = readIntInRange(lastAction == 8 ? "Choose action (0-8): " : "Choose action (0-7): ", 0, lastAction);
+            if (action == 0) break;
+            if (action == 1) { next = true; break; }
+            if (action == 6) { printMemoryReport(menu, day); continue; }
+            if (action == 7) { reconcileWithJournal(menu, day); continue; }
+            if (action == 8) { day.manageTables(); continue; }
+            runCounterAction(action, day.allOrders, day.tracker, day.eta);
+        }
+        if (!next) break;
+    }
+
+    emitSummary(menu, day);
+
+    if (allocStats) {
+        day.allocReport.print(screen());
+        printMemoryReport(menu, day);
+    }
+
+    day.store->commit();
+    if (argValue(argc, argv, "--ship")) {
+        shipper.stop();
+        screen() << Colors::MUTED << "(HQ has sales through chunk #" << shipper.shippedCount();
+        if (shipper.waitingCount()) {
+            screen() << "; " << shipper.waitingCount() << (shipper.waitingCount() == 1 ? " chunk" : " chunks")
+                << " to resend: " << shipper.lastError();
+        }
+        screen() << ")\n" << Colors::RESET;
+    }
+    if (day.journal.isOpen() && !day.journal.ok()) {
+        cerr << "Journal write failed: orders after the failure are not on disk\n";
+    }
+    else if (!day.store->ok()) {
+        cerr << "Order store (" << day.store->name() << ") write failed: some orders are not stored\n";
+    }
+
+    // --sketch-out <file>: keep the day's sketches for --merge-sketches.
+    if (const char* path = argValue(argc, argv, "--sketch-out")) {
+        if (!day.sketches.save(path)) cerr << "Cannot write sketch: " << path << "\n";
+    }
+
+    // --tree-out <file>: the closing inventory tree, for --reconcile.
+    if (const char* path = argValue(argc, argv, "--tree-out")) {
+        if (!saveStockTree(path, menu)) cerr << "Cannot write inventory tree: " << path << "\n";
+    }
+
+    // Drain the log while the menu, whose item names queued events point
+    // at, is still alive.
+    eventLog().close();
+    if (eventLog().droppedCount()) cerr << "Event log: " << eventLog().droppedCount() << " events dropped\n";
+
+    screen() << Colors::TITLE << "\nThank you for running James' Café today. Good job! ☕\n" << Colors::RESET;
+    cout.flush();
+    sessionTape().report(cerr);
+    if (sessionTape().failed()) return 3;
+    if (allocBudget && day.allocReport.callsPerOrder() > atof(allocBudget)) {
+        cerr << "Allocation budget exceeded: " << fixed << setprecision(2) << day.allocReport.callsPerOrder()
+            << " per order > " << allocBudget << "\n";
+        return 4;
+    }
     return 0;
 }